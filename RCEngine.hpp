@@ -97,6 +97,111 @@ int main() {
 
 Note that keyboard and mouse events are supported
 
+To run without a window (e.g. on a server), set displayMode to
+DisplayMode::Offscreen (software rendering into memory) or
+DisplayMode::Null (no rendering at all) in the constructor.
+fixedDeltaTime makes every frame advance by the same amount of time
+and frameLimit stops the game loop after that many frames.
+
+captureFrame() grabs the pixels of the next frame and can write them to a
+PNG or raw file on a background thread; captureInterval, capturePath and
+captureFormat dump every Nth frame. getCells() returns the cell planes.
+
+updateRate runs update with a fixed step that many times per second;
+override render(deltaTime, alpha) to interpolate between steps.
+maxFrameRate sleeps between frames instead of spinning, and vsync
+synchronizes presentation with the display.
+
+With pipelined set, render runs on a worker thread into one cell buffer
+while the main thread presents the previous one; render must not call
+SDL while pipelined, nor read what presenting writes (getDirtyCellCount,
+getTerminalBytes, getCapturedFrame), which update can. A captureFrame
+from render applies to the frame it renders, and the last frame is
+presented when the loop stops, so the same frames are shown and
+captured as without pipelined.
+
+forEachCell(shader) computes every cell in parallel on a work-stealing
+thread pool (workerThreads threads, one per core by default).
+
+Set profiler.enabled to time events, input, update, clear, render,
+renderBuffer and present for the last 240 frames; getProfiler().getStats()
+returns min/avg/p99. profilerOverlay also draws them over the top-left cells.
+
+getKeyState(SDLK_...) and getScancodeState(SDL_SCANCODE_...) return the
+pressed/released/hold state of a key; getInputEvents() lists the inputs
+since the last update in order, with their SDL timestamps.
+
+createLayer(z) allocates a transparent cell layer with its own z-order,
+visibility, offset and opacity; setDrawTarget(layer) makes the drawing
+functions draw into it. Layers with negative z lie under the console
+cells and are recomposited only when one of them changes, the others
+are blended over the console cells after render.
+
+A CellImage holds a sprite or sprite sheet with a mask of its cells;
+blit(image, x, y[, src]) draws it, copying opaque runs whole. save and
+load use the binary "RCEI" format, load maps the file where it can
+unless told to read it, as the asset manager does.
+
+A TileMap loads square chunks of a large map on demand through a loader
+callback and keeps at most maxChunks of them; drawTileMap(map) draws the
+tiles under its camera, shifting the previously drawn tiles on scroll.
+
+Characters are Unicode code points: those below 256 come from the
+tileset, and with fontPath set the others are rasterized on demand into
+a glyph cache of atlas pages; write() takes UTF-8.
+
+renderBackend = RenderBackend::Software rasterizes the cells on the CPU
+from a decoded copy of the tileset and uploads the frame as one
+streaming texture, for machines without a usable GPU driver; offscreen
+it draws straight into the frame surface. Bands of bandRows rows are
+rasterized on the thread pool, and bands that did not change are skipped.
+
+recordPath records the input events and delta time of every frame to a
+compact binary file; replayPath plays such a file back instead of SDL
+input and the clock, without sleeping, and stops at its end. With
+DisplayMode::Null this reruns a session identically for profiling.
+
+DisplayMode::Terminal writes the cells to stdout instead, one character
+per cell in 24-bit ANSI colors, for playing over SSH. Each frame sends
+only the cells that changed, written straight to the file descriptor
+so a frame of any size goes out in one write(2) where the terminal takes
+it whole; getTerminalBytes() returns its size. The alternate screen is
+left when the game loop ends and at exit.
+
+fill and drawLine clip to the draw target and write whole spans into the
+cell planes; drawRect, drawFrame, fillCircle/drawCircle,
+fillTriangle/drawTriangle, fillPolygon/drawPolygon and drawThickLine
+build on the same spans. Filled shapes, circles and frames blend each
+cell once.
+
+writeText(box, text) lays UTF-8 text out in a box with word wrap,
+alignment and inline color markup ({fg:RRGGBB}, {bg:RRGGBB}, {/}),
+without allocating. writeCachedText keeps the laid-out blocks of text
+that does not change and blits them; write and writeText take
+std::string_view.
+
+getFrameArena() is a std::pmr::memory_resource for memory that only
+lives for the frame: a bump allocator that is reset when the next frame
+starts. getPool() is a thread-safe pool resource for long-lived objects.
+The profiler records the arena allocations and bytes of every frame,
+and, in a program where one translation unit defines
+RCE_TRACK_ALLOCATIONS before including the header, every heap
+allocation (getCounterStats(ProfileCounter::HeapAllocations)).
+
+A ParticleSystem keeps up to capacity particles as arrays of positions,
+velocities and ages, which update(deltaTime[, &getThreadPool()]) moves
+with SIMD, and emits new ones from its ParticleEmitters with a seeded
+generator. drawParticles(system, blend) splats them all into the cells
+in one pass, alpha blended or additive.
+
+getAssets() loads textures, cell images and sounds on a background I/O
+thread: acquire(path, type) returns a handle at once, and the textures
+are uploaded on the main thread at the start of a frame, so the game
+runs while its assets load. Assets are shared by path and freed when
+the last handle is released. With assetReloadInterval set, files that
+change on disk are reloaded, the tileset included; setTileset(path)
+switches to another tileset once it is loaded.
+
 The tileset of this engine must be included, and the default one
 is RCE_tileset.png, which can also be found at 
 https://github.com/rainstormstudio/RCEngine
@@ -121,672 +226,6989 @@ https://github.com/rainstormstudio/RCEngine
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <bitset>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <memory_resource>
+#include <new>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/stat.h>
 
-class CellTexture {
-    SDL_Texture* texture;    // texture of the cell
-    Uint8 ch;
-    int numSrcRows;     // number of rows in src texture
-    int numSrcCols;     // number of columns in src texture
-    SDL_Rect srcRect;
-    SDL_Rect destRect;
-    SDL_Color foreColor;
-    SDL_Color backColor;
+#if defined(__linux__) || defined(__APPLE__)
+#define RCE_MMAP
+#define RCE_POSIX_WRITE
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if !defined(RCE_NO_SIMD) && defined(__AVX2__)
+#define RCE_AVX2
+#include <immintrin.h>
+#elif !defined(RCE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define RCE_SSE2
+#include <emmintrin.h>
+#endif
+
+// calls of the global operator new, counted only where RCE_TRACK_ALLOCATIONS is defined
+inline std::atomic<Uint64> rceHeapAllocations{0};
+
+#if defined(RCE_TRACK_ALLOCATIONS)
+// counting replacements of the global allocation functions; define
+// RCE_TRACK_ALLOCATIONS in one translation unit only
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size) {
+    rceHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    rceHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+#if defined(_WIN32)
+    void* memory = _aligned_malloc(std::max<size_t>(size, 1), align);
+#else
+    void* memory = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align);
+#endif
+    if (memory) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(memory, alignment);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+/**
+ * @brief Flat cell storage with one contiguous plane per attribute.
+ * Cell (x, y) lives at index y * cols + x in every plane; the screen
+ * position and tileset rect of a cell are derived when rendering.
+ */
+class CellBuffer {
+    int rows;   // number of rows of cells
+    int cols;   // number of columns of cells
+    std::vector<Uint32> chPlane;         // code point of each cell
+    std::vector<SDL_Color> forePlane;    // fore color of each cell
+    std::vector<SDL_Color> backPlane;    // back color of each cell
 
 public:
     /**
-     * @brief Construct a new Cell 
+     * @brief Construct a new Cell Buffer
      * 
-     * @param texture the texture created from the tileset
-     * @param numSrcRows number of rows in the tileset
-     * @param numSrcCols number of columns in the tileset
-     * @param srcCellWidth the width of the character in the tileset
-     * @param srcCellHeight the height of the character in the tileset
-     * @param destCellWidth the width of the cell
-     * @param destCellHeight the height of the cell
+     * @param rows number of rows of cells
+     * @param cols number of columns of cells
      */
-    CellTexture(SDL_Texture* texture, int numSrcRows, int numSrcCols, 
-            int srcCellWidth, int srcCellHeight, int destCellWidth, int destCellHeight)
-    : texture{texture}, numSrcRows{numSrcRows}, numSrcCols{numSrcCols} {
-        srcRect = {0, 0, srcCellWidth, srcCellHeight};
-        destRect = {0, 0, destCellWidth, destCellHeight};
-        foreColor = {255, 255, 255, 255};
-        backColor = {0, 0, 0, 255};
-        ch = 0;
+    CellBuffer(int rows = 0, int cols = 0) {
+        resize(rows, cols);
     }
 
     /**
-     * @brief Set the character of the cell
+     * @brief resizes the buffer and resets every cell
      * 
-     * @param ch 
+     * @param rows number of rows of cells
+     * @param cols number of columns of cells
      */
-    inline void setCh(Uint8 ch) {
-        this->ch = ch;
-        srcRect.x = (ch % numSrcCols) * srcRect.w;
-        srcRect.y = (ch / numSrcCols) * srcRect.h;
+    void resize(int rows, int cols) {
+        this->rows = rows;
+        this->cols = cols;
+        chPlane.assign(rows * cols, 0);
+        forePlane.assign(rows * cols, {255, 255, 255, 255});
+        backPlane.assign(rows * cols, {0, 0, 0, 255});
     }
 
     /**
-     * @brief Set the coordinate of the destRect
+     * @brief sets every cell to ch, foreColor and backColor
      * 
-     * @param x x-coordinate
-     * @param y y-coordinate
+     * @param ch character
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
      */
-    inline void setDestPosition(int x, int y) {
-        destRect.x = x;
-        destRect.y = y;
+    void clear(Uint32 ch, SDL_Color foreColor, SDL_Color backColor) {
+        std::fill(chPlane.begin(), chPlane.end(), ch);
+        std::fill(forePlane.begin(), forePlane.end(), foreColor);
+        std::fill(backPlane.begin(), backPlane.end(), backColor);
     }
 
     /**
-     * @brief Set the coordinate of the srcRect
+     * @brief sets every cell of a rectangle to ch, foreColor and backColor
      * 
-     * @param x 
-     * @param y 
+     * @param ch character
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     * @param rect (x, y, w, h), must lie inside the buffer
      */
-    inline void setSrcPosition(int x, int y) {
-        srcRect.x = x;
-        srcRect.y = y;
+    void clear(Uint32 ch, SDL_Color foreColor, SDL_Color backColor, SDL_Rect rect) {
+        for (int y = rect.y; y < rect.y + rect.h; y ++) {
+            int row = index(rect.x, y);
+            std::fill(chPlane.begin() + row, chPlane.begin() + row + rect.w, ch);
+            std::fill(forePlane.begin() + row, forePlane.begin() + row + rect.w, foreColor);
+            std::fill(backPlane.begin() + row, backPlane.begin() + row + rect.w, backColor);
+        }
     }
 
-    /**
-     * @brief Set the Fore Color of the cell
-     * 
-     * @param r red
-     * @param g green
-     * @param b blue
-     * @param a alpha
-     */
-    inline void setForeColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
-        foreColor = {r, g, b, a};
+    int getRows() const {
+        return rows;
+    }
+
+    int getCols() const {
+        return cols;
     }
 
     /**
-     * @brief Set the Fore Color of the cell
+     * @brief Get the number of cells
      * 
-     * @param color (r, g, b, a)
+     * @return int 
      */
-    inline void setForeColor(SDL_Color color) {
-        foreColor = color;
+    int size() const {
+        return rows * cols;
     }
 
     /**
-     * @brief Set the Back Color of the cell
+     * @brief Get the plane index of the cell at (x, y)
      * 
-     * @param r red
-     * @param g green
-     * @param b blue
-     * @param a alpha
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @return int 
      */
-    inline void setBackColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a) {
-        backColor = {r, g, b, a};
+    inline int index(int x, int y) const {
+        return y * cols + x;
+    }
+
+    inline Uint32* chs() {
+        return chPlane.data();
+    }
+
+    inline const Uint32* chs() const {
+        return chPlane.data();
+    }
+
+    inline SDL_Color* foreColors() {
+        return forePlane.data();
+    }
+
+    inline const SDL_Color* foreColors() const {
+        return forePlane.data();
     }
 
+    inline SDL_Color* backColors() {
+        return backPlane.data();
+    }
+
+    inline const SDL_Color* backColors() const {
+        return backPlane.data();
+    }
+};
+
+/**
+ * @brief A plane of cells drawn over or under the console. Cells start
+ * transparent; a cell shows its character only where its fore color is
+ * not transparent, elsewhere the character below stays. The engine
+ * keeps what it composited from a layer until the layer changes.
+ * 
+ */
+class CellLayer {
+    CellBuffer cells;
+    int z;          // layers with negative z are drawn under the console cells, the others over them
+    bool visible;
+    int offsetX;    // console column of the first column of the layer
+    int offsetY;    // console row of the first row of the layer
+    Uint8 opacity;  // scales the alpha of every cell
+    bool dirty;     // changed since the engine last composited it
+    SDL_Rect bounds;    // the cells that are not fully transparent, valid when not dirty
+
+    friend class RCEngine;
+
+public:
     /**
-     * @brief Set the Back Color of the cell
+     * @brief Construct a new transparent Cell Layer
      * 
-     * @param color (r, g, b, a)
+     * @param rows number of rows of cells
+     * @param cols number of columns of cells
+     * @param z the order of the layer
      */
-    inline void setBackColor(SDL_Color color) {
-        backColor = color;
+    CellLayer(int rows, int cols, int z) : cells{rows, cols}, z{z}, visible{true}, offsetX{0}, offsetY{0}, opacity{255}, dirty{true}, bounds{0, 0, 0, 0} {
+        clear();
     }
 
     /**
-     * @brief Get the charactor of the cell
+     * @brief makes every cell transparent
      * 
-     * @return Uint8 
      */
-    Uint8 getCh() const {
-        return ch;
+    void clear() {
+        cells.clear(' ', {255, 255, 255, 0}, {0, 0, 0, 0});
+        dirty = true;
     }
 
     /**
-     * @brief Get the Fore Color of the cell
+     * @brief Get the cells for direct modification, which marks the
+     * layer as changed
      * 
-     * @return SDL_Color 
+     * @return CellBuffer& 
      */
-    SDL_Color getForeColor() const {
-        return foreColor;
+    CellBuffer& getCells() {
+        dirty = true;
+        return cells;
+    }
+
+    const CellBuffer& getCells() const {
+        return cells;
+    }
+
+    void setZ(int z) {
+        dirty = dirty || this->z != z;
+        this->z = z;
+    }
+
+    int getZ() const {
+        return z;
+    }
+
+    void setVisible(bool visible) {
+        dirty = dirty || this->visible != visible;
+        this->visible = visible;
+    }
+
+    bool isVisible() const {
+        return visible;
     }
 
     /**
-     * @brief Get the Back Color of the cell
+     * @brief moves the layer on the console
      * 
-     * @return SDL_Color 
+     * @param x console column of the first column of the layer
+     * @param y console row of the first row of the layer
      */
-    SDL_Color getBackColor() const {
-        return backColor;
+    void setOffset(int x, int y) {
+        dirty = dirty || offsetX != x || offsetY != y;
+        offsetX = x;
+        offsetY = y;
+    }
+
+    int getOffsetX() const {
+        return offsetX;
+    }
+
+    int getOffsetY() const {
+        return offsetY;
+    }
+
+    void setOpacity(Uint8 opacity) {
+        dirty = dirty || this->opacity != opacity;
+        this->opacity = opacity;
+    }
+
+    Uint8 getOpacity() const {
+        return opacity;
     }
 
     /**
-     * @brief renders the cell to the screen
+     * @brief marks the layer as changed, for changes the layer cannot see
      * 
-     * @param renderer 
      */
-    void render(SDL_Renderer* renderer) {
-        SDL_SetTextureColorMod(texture, backColor.r, backColor.g, backColor.b);
-        SDL_SetTextureAlphaMod(texture, backColor.a);
-        SDL_Rect backSrcRect = {static_cast<int>((219 % numSrcCols) * srcRect.w), static_cast<int>((219 / numSrcCols) * srcRect.h), srcRect.w, srcRect.h};
-        SDL_RenderCopyEx(renderer, texture, &backSrcRect, &destRect, 0.0, nullptr, SDL_FLIP_NONE);
-        SDL_SetTextureColorMod(texture, foreColor.r, foreColor.g, foreColor.b);
-        SDL_SetTextureAlphaMod(texture, foreColor.a);
-        SDL_RenderCopyEx(renderer, texture, &srcRect, &destRect, 0.0, nullptr, SDL_FLIP_NONE);
+    void markDirty() {
+        dirty = true;
     }
 };
 
-class RCEngine {
-protected:
-    // graphics info
-    int cellRows;   // number of rows of cells
-    int cellCols;   // number of columns of cells
-    int cellWidth;  // the width of the cell
-    int cellHeight; // the height of the cell
-    int screenWidth;    // the width of the screen
-    int screenHeight;   // the height of the screen
-    std::string windowTitle; // the title of the window
-
-    // inputs
-    struct KeyState {
-        bool pressed;
-        bool released;
-        bool hold;
+/**
+ * @brief A rectangle of cells drawn as a unit by RCEngine::blit, with a
+ * mask telling which cells are part of the image. Images are stored as
+ * "RCEI", rows, cols, then the ch (32-bit), fore, back and mask planes;
+ * load maps the file where it can, so large sprite sheets are paged in
+ * on use.
+ * 
+ */
+class CellImage {
+public:
+    /**
+     * @brief cells of a row that are all in the mask, and either all
+     * opaque or not
+     * 
+     */
+    struct Run {
+        int begin;      // first column
+        int end;        // one past the last column
+        bool opaque;    // every fore and back color of the run is opaque
     };
-    std::vector<bool> keyInput;
-    std::vector<bool> prevKeyInput;
-    std::vector<KeyState> keyState;
-    std::vector<bool> cursorInput;
-    std::vector<bool> prevCursorInput;
-    std::vector<KeyState> cursorState;
-    int cursorPosX;
-    int cursorPosY;
 
 private:
-    SDL_Window* window;
-    SDL_Renderer* renderer;
-    SDL_Texture* tileset;
-    std::vector<std::vector<std::shared_ptr<CellTexture>>> buffer;
+    int rows;
+    int cols;
+    std::vector<Uint8> storage;     // the planes when they are not mapped
+    Uint8* data;    // the ch, fore, back and mask planes, one after the other
+    void* mapping;  // the mapped file holding data, if any
+    size_t mappingSize;
+    mutable std::vector<Run> runs;  // the runs of every row
+    mutable std::vector<int> rowRuns;   // index in runs of the first run of each row, and one past the last row
+    mutable bool runsValid;
 
-    // events info
-    SDL_Event event;
+public:
+    /**
+     * @brief Construct a new Cell Image with no cell in the mask
+     * 
+     * @param rows number of rows of cells
+     * @param cols number of columns of cells
+     */
+    CellImage(int rows = 0, int cols = 0) : rows{0}, cols{0}, data{nullptr}, mapping{nullptr}, mappingSize{0}, runsValid{false} {
+        resize(rows, cols);
+    }
 
-    // inputs
-    const int TOTAL_KEYS = 332;
-    const int TOTAL_CURSOR_STATES = 5;
+    CellImage(const CellImage&) = delete;
+    CellImage& operator=(const CellImage&) = delete;
 
-    // game info
-    bool loop;
+    CellImage(CellImage&& other) : CellImage() {
+        swap(other);
+    }
 
-public:
-    RCEngine() {
-        cellRows = 0;
-        cellCols = 0;
-        screenWidth = 0;
-        screenHeight = 0;
-        windowTitle = "RCEngine";
+    CellImage& operator=(CellImage&& other) {
+        swap(other);
+        return *this;
+    }
 
-        keyInput = std::vector<bool>(TOTAL_KEYS, false);
-        prevKeyInput = std::vector<bool>(TOTAL_KEYS, false);
-        keyState = std::vector<KeyState>(TOTAL_KEYS, {false, false, false});
-        cursorInput = std::vector<bool>(TOTAL_CURSOR_STATES, false);
-        prevCursorInput = std::vector<bool>(TOTAL_CURSOR_STATES, false);
-        cursorState = std::vector<KeyState>(TOTAL_CURSOR_STATES, {false, false, false});
+    ~CellImage() {
+        unmap();
     }
 
-    ~RCEngine() {}
+    void swap(CellImage& other) {
+        std::swap(rows, other.rows);
+        std::swap(cols, other.cols);
+        storage.swap(other.storage);
+        std::swap(data, other.data);
+        std::swap(mapping, other.mapping);
+        std::swap(mappingSize, other.mappingSize);
+        runs.swap(other.runs);
+        rowRuns.swap(other.rowRuns);
+        std::swap(runsValid, other.runsValid);
+    }
 
     /**
-     * @brief Creates the console window
+     * @brief resizes the image and removes every cell from the mask
      * 
-     * @param tilesetPath the path to the tileset
      * @param rows number of rows of cells
      * @param cols number of columns of cells
-     * @param fontWidth the width of the cell
-     * @param fontHeight the height of the cell
-     * @return true
-     * @return false
      */
-    bool createConsole(std::string tilesetPath = "./RCE_tileset.png", int rows = 30, int cols = 40, int fontWidth = 20, int fontHeight = 20) {
-        cellRows = rows;
-        cellCols = cols;
-        cellWidth = fontWidth;
-        cellHeight = fontHeight;
-        int numSrcRows = 16;
-        int numSrcCols = 16;
-        screenWidth = cellCols * cellWidth;
-        screenHeight = cellRows * cellHeight;
+    void resize(int rows, int cols) {
+        unmap();
+        this->rows = rows;
+        this->cols = cols;
+        storage.assign(static_cast<size_t>(rows) * cols * 13, 0);
+        data = storage.data();
+        runsValid = false;
+    }
 
-        window = nullptr;
-        renderer = nullptr;
-        tileset = nullptr;
+    int getRows() const {
+        return rows;
+    }
+
+    int getCols() const {
+        return cols;
+    }
+
+    /**
+     * @brief sets the cell at (x, y) and adds it to the mask
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @param ch character
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     */
+    void set(int x, int y, Uint32 ch, SDL_Color foreColor, SDL_Color backColor) {
+        if (0 <= x && x < cols && 0 <= y && y < rows) {
+            int index = y * cols + x;
+            chs()[index] = ch;
+            foreColors()[index] = foreColor;
+            backColors()[index] = backColor;
+            mask()[index] = 1;
+        }
+    }
+
+    /**
+     * @brief removes the cell at (x, y) from the mask
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     */
+    void erase(int x, int y) {
+        if (0 <= x && x < cols && 0 <= y && y < rows) {
+            mask()[y * cols + x] = 0;
+        }
+    }
+
+    // the non-const plane accessors assume the planes are modified
+
+    Uint32* chs() {
+        runsValid = false;
+        return reinterpret_cast<Uint32*>(data);
+    }
+
+    const Uint32* chs() const {
+        return reinterpret_cast<const Uint32*>(data);
+    }
+
+    SDL_Color* foreColors() {
+        runsValid = false;
+        return reinterpret_cast<SDL_Color*>(data + size() * 4);
+    }
+
+    const SDL_Color* foreColors() const {
+        return reinterpret_cast<const SDL_Color*>(data + size() * 4);
+    }
+
+    SDL_Color* backColors() {
+        runsValid = false;
+        return reinterpret_cast<SDL_Color*>(data + size() * 8);
+    }
+
+    const SDL_Color* backColors() const {
+        return reinterpret_cast<const SDL_Color*>(data + size() * 8);
+    }
+
+    /**
+     * @brief Get the mask plane, non-zero for the cells of the image
+     * 
+     * @return Uint8* 
+     */
+    Uint8* mask() {
+        runsValid = false;
+        return data + size() * 12;
+    }
+
+    const Uint8* mask() const {
+        return data + size() * 12;
+    }
+
+    /**
+     * @brief Get the number of cells
+     * 
+     * @return size_t 
+     */
+    size_t size() const {
+        return static_cast<size_t>(rows) * cols;
+    }
+
+    /**
+     * @brief Get the runs of a row, computing the runs of the image
+     * after it changed
+     * 
+     * @param y the row
+     * @param count set to the number of runs
+     * @return const Run* 
+     */
+    const Run* getRuns(int y, int& count) const {
+        if (!runsValid) {
+            findRuns();
+        }
+        count = rowRuns[y + 1] - rowRuns[y];
+        return runs.data() + rowRuns[y];
+    }
+
+    /**
+     * @brief writes the image to a file
+     * 
+     * @param path 
+     * @return true if the file was written
+     */
+    bool save(const std::string& path) const {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Failed to open " << path << std::endl;
+            return false;
+        }
+        Uint32 header[2] = {static_cast<Uint32>(rows), static_cast<Uint32>(cols)};
+        bool written = fwrite("RCEI", 1, 4, file) == 4
+            && fwrite(header, sizeof(header), 1, file) == 1
+            && fwrite(data, 1, size() * 13, file) == size() * 13;
+        if (fclose(file) != 0 || !written) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief reads an image written by save. With map, the file is
+     * mapped copy-on-write where mmap exists: modifying the image never
+     * changes the file, but the pages not yet modified still read it,
+     * so the file must not be rewritten while the image uses it.
+     * 
+     * @param path 
+     * @param map map the file instead of reading it into the image
+     * @return true if the image was loaded, otherwise it is unchanged
+     */
+    bool load(const std::string& path, bool map = true) {
+#if defined(RCE_MMAP)
+        if (map) {
+            return loadMapped(path);
+        }
+#else
+        (void)map;
+#endif
+        const long headerSize = 12;
+        Uint32 header[2] = {0, 0};
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) {
+            std::cerr << "Failed to open " << path << std::endl;
+            return false;
+        }
+        char magic[4];
+        bool valid = fread(magic, 1, 4, file) == 4 && memcmp(magic, "RCEI", 4) == 0
+            && fread(header, sizeof(header), 1, file) == 1
+            && validSize(header[0], header[1]);
+        size_t count = static_cast<size_t>(header[0]) * header[1];
+        long fileSize = -1;
+        if (valid && fseek(file, 0, SEEK_END) == 0) {
+            fileSize = ftell(file);
+        }
+        // checked before allocating, a file being rewritten may be shorter
+        valid = valid && fileSize >= headerSize && static_cast<size_t>(fileSize - headerSize) == count * 13
+            && fseek(file, headerSize, SEEK_SET) == 0;
+        std::vector<Uint8> cells;
+        if (valid) {
+            cells.resize(count * 13);
+            valid = fread(cells.data(), 1, cells.size(), file) == cells.size();
+        }
+        fclose(file);
+        if (!valid) {
+            std::cerr << "Invalid cell image " << path << std::endl;
+            return false;
+        }
+        unmap();
+        storage = std::move(cells);
+        rows = header[0];
+        cols = header[1];
+        data = storage.data();
+        runsValid = false;
+        return true;
+    }
+
+private:
+    /**
+     * @brief checks the dimensions read from a file, rows, cols and
+     * their product must fit in an int since cells are indexed with one
+     * 
+     * @param rows 
+     * @param cols 
+     * @return true if an image of that size can be indexed
+     */
+    static bool validSize(Uint32 rows, Uint32 cols) {
+        return rows <= INT_MAX && cols <= INT_MAX
+            && static_cast<Uint64>(rows) * cols <= INT_MAX;
+    }
+
+    void unmap() {
+#if defined(RCE_MMAP)
+        if (mapping) {
+            munmap(mapping, mappingSize);
+        }
+#endif
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+
+#if defined(RCE_MMAP)
+    bool loadMapped(const std::string& path) {
+        const size_t headerSize = 12;
+        Uint32 header[2];
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            std::cerr << "Failed to open " << path << std::endl;
+            return false;
+        }
+        struct stat info;
+        void* mapped = MAP_FAILED;
+        if (fstat(file, &info) == 0 && static_cast<size_t>(info.st_size) >= headerSize) {
+            mapped = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+        }
+        close(file);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Failed to map " << path << std::endl;
+            return false;
+        }
+        const Uint8* bytes = static_cast<const Uint8*>(mapped);
+        memcpy(header, bytes + 4, sizeof(header));
+        size_t count = static_cast<size_t>(header[0]) * header[1];
+        if (memcmp(bytes, "RCEI", 4) != 0 || !validSize(header[0], header[1])
+            || static_cast<size_t>(info.st_size) != headerSize + count * 13) {
+            munmap(mapped, info.st_size);
+            std::cerr << "Invalid cell image " << path << std::endl;
+            return false;
+        }
+        unmap();
+        storage.clear();
+        storage.shrink_to_fit();
+        rows = header[0];
+        cols = header[1];
+        mapping = mapped;
+        mappingSize = info.st_size;
+        data = static_cast<Uint8*>(mapped) + headerSize;
+        runsValid = false;
+        return true;
+    }
+#endif
+
+    /**
+     * @brief splits every row into runs of cells in the mask
+     * 
+     */
+    void findRuns() const {
+        runs.clear();
+        rowRuns.assign(rows + 1, 0);
+        const Uint8* cellMask = mask();
+        const SDL_Color* fore = foreColors();
+        const SDL_Color* back = backColors();
+        for (int y = 0; y < rows; y ++) {
+            rowRuns[y] = static_cast<int>(runs.size());
+            int row = y * cols;
+            int x = 0;
+            while (x < cols) {
+                if (!cellMask[row + x]) {
+                    x ++;
+                    continue;
+                }
+                // runs also split where the opacity changes
+                Run run = {x, x, fore[row + x].a == 255 && back[row + x].a == 255};
+                while (run.end < cols && cellMask[row + run.end]
+                    && (fore[row + run.end].a == 255 && back[row + run.end].a == 255) == run.opaque) {
+                    run.end ++;
+                }
+                runs.push_back(run);
+                x = run.end;
+            }
+        }
+        rowRuns[rows] = static_cast<int>(runs.size());
+        runsValid = true;
+    }
+};
+
+/**
+ * @brief The way renderBuffer submits the cells to the renderer
+ * 
+ */
+enum class RenderBackend {
+    Texture,    // two SDL_RenderCopyEx calls per cell
+    Geometry,   // one SDL_RenderGeometry call for the whole console
+    Software    // cells rasterized on the CPU and uploaded as one streaming texture
+};
+
+/**
+ * @brief Where the console is displayed
+ * 
+ */
+enum class DisplayMode {
+    Window,     // an SDL window, with audio
+    Offscreen,  // a software renderer drawing into an in-memory surface
+    Null,       // no window and no renderer, nothing is drawn
+    Terminal    // the cells are written to stdout with 24-bit ANSI colors, one character per cell
+};
+
+/**
+ * @brief File format of a captured frame
+ * 
+ */
+enum class CaptureFormat {
+    PNG,    // composed pixels as a PNG image
+    Raw,    // composed pixels: "RCEF", width, height, then ARGB8888 pixels
+    Cells   // cell planes: "RCEC", rows, cols, then the ch (32-bit), fore and back planes
+};
+
+/**
+ * @brief The box-drawing characters of drawFrame
+ * 
+ */
+enum class FrameStyle {
+    Single,     // ┌─┐ in CP437
+    Double      // ╔═╗ in CP437
+};
+
+/**
+ * @brief The alignment of the lines of writeText
+ * 
+ */
+enum class TextAlign {
+    Left,
+    Center,
+    Right
+};
+
+/**
+ * @brief Pixels of a composed frame
+ * 
+ */
+struct FrameCapture {
+    long frame;     // the frame number the pixels belong to
+    int width;
+    int height;
+    std::vector<Uint32> pixels;     // ARGB8888, row by row
+};
+
+/**
+ * @brief Writes captured frames to disk on a background thread so that
+ * capturing does not stall the game loop. Buffers of written frames
+ * are recycled for later captures.
+ * 
+ */
+class FrameWriter {
+    struct Job {
+        std::string path;
+        CaptureFormat format;
+        int width;
+        int height;
+        std::vector<Uint32> pixels;
+        CellBuffer cells;
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;   // signals the worker
+    std::condition_variable idle;   // signals waiting producers
+    std::deque<Job> jobs;
+    std::vector<std::vector<Uint32>> freePixels;
+    std::vector<CellBuffer> freeCells;
+    bool running;
+    bool busy;      // the worker is writing a job
+    const size_t MAX_PENDING = 8;   // push blocks beyond this many queued frames
+
+public:
+    FrameWriter() : running{false}, busy{false} {}
+
+    ~FrameWriter() {
+        stop();
+    }
+
+    /**
+     * @brief queues composed pixels to be written to path
+     * 
+     * @param path the file to write
+     * @param format PNG or Raw
+     * @param width the width of the frame
+     * @param height the height of the frame
+     * @param pixels ARGB8888 pixels, taken over by the writer
+     */
+    void push(std::string path, CaptureFormat format, int width, int height, std::vector<Uint32>&& pixels) {
+        Job job;
+        job.path = std::move(path);
+        job.format = format;
+        job.width = width;
+        job.height = height;
+        job.pixels = std::move(pixels);
+        push(std::move(job));
+    }
+
+    /**
+     * @brief queues a copy of the cell planes to be written to path
+     * 
+     * @param path the file to write
+     * @param cells the cells to write
+     */
+    void push(std::string path, const CellBuffer& cells) {
+        Job job;
+        job.path = std::move(path);
+        job.format = CaptureFormat::Cells;
+        job.width = cells.getCols();
+        job.height = cells.getRows();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freeCells.empty()) {
+                job.cells = std::move(freeCells.back());
+                freeCells.pop_back();
+            }
+        }
+        job.cells = cells;
+        push(std::move(job));
+    }
+
+    /**
+     * @brief Get a pixel buffer of size count, reusing the buffer of
+     * a written frame when possible
+     * 
+     * @param count number of pixels
+     * @return std::vector<Uint32> 
+     */
+    std::vector<Uint32> acquirePixels(size_t count) {
+        std::vector<Uint32> pixels;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!freePixels.empty()) {
+                pixels = std::move(freePixels.back());
+                freePixels.pop_back();
+            }
+        }
+        pixels.resize(count);
+        return pixels;
+    }
+
+    /**
+     * @brief waits until every queued frame is written
+     * 
+     */
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this]() { return jobs.empty() && !busy; });
+    }
+
+    /**
+     * @brief writes the queued frames and stops the worker
+     * 
+     */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!running) {
+                return;
+            }
+            running = false;
+        }
+        wake.notify_all();
+        worker.join();
+    }
+
+private:
+    void push(Job&& job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!running) {
+            running = true;
+            worker = std::thread(&FrameWriter::run, this);
+        }
+        idle.wait(lock, [this]() { return jobs.size() < MAX_PENDING; });
+        jobs.push_back(std::move(job));
+        lock.unlock();
+        wake.notify_one();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return !jobs.empty() || !running; });
+            if (jobs.empty()) {
+                break;
+            }
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+            lock.unlock();
+
+            if (!write(job)) {
+                std::cerr << "Failed to write frame " << job.path << ": " << SDL_GetError() << std::endl;
+            }
+
+            lock.lock();
+            busy = false;
+            if (job.format == CaptureFormat::Cells) {
+                freeCells.push_back(std::move(job.cells));
+            } else {
+                freePixels.push_back(std::move(job.pixels));
+            }
+            idle.notify_all();
+        }
+    }
+
+    static bool write(Job& job) {
+        if (job.format == CaptureFormat::PNG) {
+            SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(job.pixels.data(), job.width, job.height, 32, job.width * 4, SDL_PIXELFORMAT_ARGB8888);
+            if (!surface) {
+                return false;
+            }
+            bool written = IMG_SavePNG(surface, job.path.c_str()) == 0;
+            SDL_FreeSurface(surface);
+            return written;
+        }
+
+        FILE* file = fopen(job.path.c_str(), "wb");
+        if (!file) {
+            SDL_SetError("cannot open file");
+            return false;
+        }
+        Uint32 header[2] = {static_cast<Uint32>(job.width), static_cast<Uint32>(job.height)};
+        bool written = true;
+        if (job.format == CaptureFormat::Raw) {
+            written = fwrite("RCEF", 1, 4, file) == 4
+                && fwrite(header, sizeof(header), 1, file) == 1
+                && fwrite(job.pixels.data(), sizeof(Uint32), job.pixels.size(), file) == job.pixels.size();
+        } else {
+            size_t count = job.cells.size();
+            header[0] = job.cells.getRows();
+            header[1] = job.cells.getCols();
+            written = fwrite("RCEC", 1, 4, file) == 4
+                && fwrite(header, sizeof(header), 1, file) == 1
+                && fwrite(job.cells.chs(), sizeof(Uint32), count, file) == count
+                && fwrite(job.cells.foreColors(), sizeof(SDL_Color), count, file) == count
+                && fwrite(job.cells.backColors(), sizeof(SDL_Color), count, file) == count;
+        }
+        if (fclose(file) != 0 || !written) {
+            SDL_SetError("cannot write file");
+            return false;
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief A pool of worker threads running parallel loops. Each
+ * participant (the workers and the calling thread) starts with an
+ * equal share of the loop, takes tiles from the front of its share, and
+ * steals the back half of another share once its own runs out.
+ * 
+ */
+class ThreadPool {
+    struct alignas(64) Share {
+        std::mutex mutex;
+        int begin;
+        int end;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Share>> shares;     // one per worker, the last one for the caller
+    std::mutex mutex;
+    std::mutex callMutex;   // serializes parallelFor calls from different threads
+    std::condition_variable wake;   // signals the workers
+    std::condition_variable done;   // signals the caller
+    long generation;    // incremented for every loop
+    int active;     // workers still running the current loop
+    bool stopping;
+
+    // the current loop
+    void (*invoke)(const void* function, int begin, int end);
+    const void* function;
+    int grain;
+
+public:
+    /**
+     * @brief Construct a new Thread Pool
+     * 
+     * @param threads total number of threads working on a loop including
+     * the caller, 0 for one per hardware thread
+     */
+    explicit ThreadPool(int threads = 0) : generation{0}, active{0}, stopping{false}, invoke{nullptr}, function{nullptr}, grain{1} {
+        if (threads <= 0) {
+            threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        }
+        for (int i = 0; i < threads; i ++) {
+            shares.push_back(std::unique_ptr<Share>(new Share()));
+            shares.back()->begin = 0;
+            shares.back()->end = 0;
+        }
+        for (int i = 0; i < threads - 1; i ++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Get the number of threads working on a loop including the caller
+     * 
+     * @return int 
+     */
+    int size() const {
+        return static_cast<int>(shares.size());
+    }
+
+    /**
+     * @brief calls f(begin, end) on tiles of [0, count) in parallel and
+     * returns when all of them are done. Nested calls from inside a
+     * tile run serially.
+     * 
+     * @param count number of items
+     * @param grain number of items in a tile
+     * @param f callable taking (int begin, int end)
+     */
+    template <typename F>
+    void parallelFor(int count, int grain, F&& f) {
+        grain = std::max(1, grain);
+        if (workers.empty() || count <= grain || insideLoop()) {
+            for (int begin = 0; begin < count; begin += grain) {
+                f(begin, std::min(begin + grain, count));
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> call(callMutex);
+        int participants = size();
+        for (int i = 0; i < participants; i ++) {
+            std::lock_guard<std::mutex> lock(shares[i]->mutex);
+            shares[i]->begin = static_cast<int>(static_cast<long long>(count) * i / participants);
+            shares[i]->end = static_cast<int>(static_cast<long long>(count) * (i + 1) / participants);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->invoke = [](const void* function, int begin, int end) {
+                (*static_cast<const typename std::remove_reference<F>::type*>(function))(begin, end);
+            };
+            this->function = &f;
+            this->grain = grain;
+            active = static_cast<int>(workers.size());
+            generation ++;
+        }
+        wake.notify_all();
+
+        insideLoop() = true;
+        run(participants - 1);
+        insideLoop() = false;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return active == 0; });
+    }
+
+private:
+    /**
+     * @brief whether the current thread is running a tile
+     * 
+     * @return bool& 
+     */
+    static bool& insideLoop() {
+        static thread_local bool inside = false;
+        return inside;
+    }
+
+    void workerLoop(int self) {
+        insideLoop() = true;
+        long seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+            if (stopping) {
+                break;
+            }
+            seen = generation;
+            lock.unlock();
+
+            run(self);
+
+            lock.lock();
+            if (-- active == 0) {
+                done.notify_one();
+            }
+        }
+    }
+
+    /**
+     * @brief runs tiles of the own share, then steals from the others
+     * until no work is left
+     * 
+     * @param self the index of the own share
+     */
+    void run(int self) {
+        Share& own = *shares[self];
+        int participants = size();
+        while (true) {
+            int begin;
+            int end;
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                begin = own.begin;
+                end = std::min(own.begin + grain, own.end);
+                own.begin = end;
+            }
+            if (begin < end) {
+                invoke(function, begin, end);
+                continue;
+            }
+
+            // only one share is locked at a time, so thieves never deadlock
+            bool stolen = false;
+            for (int i = 1; i < participants && !stolen; i ++) {
+                Share& victim = *shares[(self + i) % participants];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                int remaining = victim.end - victim.begin;
+                if (remaining > 0) {
+                    begin = victim.begin + remaining / 2;
+                    end = victim.end;
+                    victim.end = begin;
+                    stolen = true;
+                }
+            }
+            if (!stolen) {
+                break;
+            }
+            std::lock_guard<std::mutex> lock(own.mutex);
+            own.begin = begin;
+            own.end = end;
+        }
+    }
+};
+
+/**
+ * @brief The phases of a frame timed by FrameProfiler
+ * 
+ */
+enum class ProfilePhase {
+    Events,     // polling SDL events
+    Input,      // updating key and cursor states
+    Update,     // update, all fixed steps of the frame
+    Clear,      // clearBuffer
+    Render,     // render
+    RenderBuffer,   // renderBuffer, without present
+    Present,    // SDL_RenderPresent
+    Frame,      // the whole frame, from one end of frame to the next
+    Count
+};
+
+/**
+ * @brief The counts of a frame recorded by FrameProfiler
+ * 
+ */
+enum class ProfileCounter {
+    HeapAllocations,    // calls of the global operator new, 0 without RCE_TRACK_ALLOCATIONS
+    ArenaAllocations,   // allocations from the frame arena
+    ArenaBytes,         // bytes allocated from the frame arena
+    Count
+};
+
+/**
+ * @brief Times the phases of recent frames. Timing is off unless
+ * enabled is set, and a disabled Scope costs a single branch.
+ * 
+ */
+class FrameProfiler {
+public:
+    static constexpr int HISTORY = 240;     // number of frames kept
+    static constexpr int NUM_PHASES = static_cast<int>(ProfilePhase::Count);
+    static constexpr int NUM_COUNTERS = static_cast<int>(ProfileCounter::Count);
+
+    /**
+     * @brief statistics of a phase over the kept frames, in milliseconds
+     * 
+     */
+    struct Stats {
+        double min;
+        double avg;
+        double p99;
+    };
+
+    /**
+     * @brief Adds the time between its construction and destruction
+     * to a phase of the current frame
+     * 
+     */
+    class Scope {
+        FrameProfiler* profiler;
+        ProfilePhase phase;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+        Scope(FrameProfiler& profiler, ProfilePhase phase) : profiler{profiler.enabled ? &profiler : nullptr}, phase{phase} {
+            if (this->profiler) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~Scope() {
+            if (profiler) {
+                profiler->current[static_cast<int>(phase)] += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+    };
+
+    bool enabled;
+
+private:
+    float samples[HISTORY][NUM_PHASES];     // ring buffer of frames, in milliseconds
+    float current[NUM_PHASES];  // the frame being timed
+    float counterSamples[HISTORY][NUM_COUNTERS];    // the counters of the frames in samples
+    float currentCounters[NUM_COUNTERS];
+    int head;   // where the next frame goes in samples
+    int count;  // number of frames in samples
+    std::chrono::steady_clock::time_point frameStart;
+
+public:
+    FrameProfiler() : enabled{false}, head{0}, count{0} {
+        std::fill(&current[0], &current[0] + NUM_PHASES, 0.0f);
+        std::fill(&currentCounters[0], &currentCounters[0] + NUM_COUNTERS, 0.0f);
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief drops the time gathered so far and starts a new frame
+     * 
+     */
+    void restart() {
+        std::fill(&current[0], &current[0] + NUM_PHASES, 0.0f);
+        std::fill(&currentCounters[0], &currentCounters[0] + NUM_COUNTERS, 0.0f);
+        frameStart = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief sets a counter of the current frame
+     * 
+     * @param counter 
+     * @param value 
+     */
+    void setCounter(ProfileCounter counter, double value) {
+        currentCounters[static_cast<int>(counter)] = static_cast<float>(value);
+    }
+
+    /**
+     * @brief stores the current frame in the ring buffer
+     * 
+     */
+    void endFrame() {
+        auto now = std::chrono::steady_clock::now();
+        if (!enabled) {
+            frameStart = now;
+            return;
+        }
+        current[static_cast<int>(ProfilePhase::Frame)] = std::chrono::duration<float, std::milli>(now - frameStart).count();
+        frameStart = now;
+        std::copy(&current[0], &current[0] + NUM_PHASES, &samples[head][0]);
+        std::copy(&currentCounters[0], &currentCounters[0] + NUM_COUNTERS, &counterSamples[head][0]);
+        std::fill(&current[0], &current[0] + NUM_PHASES, 0.0f);
+        std::fill(&currentCounters[0], &currentCounters[0] + NUM_COUNTERS, 0.0f);
+        head = (head + 1) % HISTORY;
+        count = std::min(count + 1, HISTORY);
+    }
+
+    /**
+     * @brief Get the number of frames kept
+     * 
+     * @return int 
+     */
+    int getFrameCount() const {
+        return count;
+    }
+
+    /**
+     * @brief Get the min, average and 99th percentile of a phase over
+     * the kept frames
+     * 
+     * @param phase 
+     * @return Stats in milliseconds, all 0 if no frame was timed
+     */
+    Stats getStats(ProfilePhase phase) const {
+        float values[HISTORY];
+        for (int i = 0; i < count; i ++) {
+            values[i] = samples[i][static_cast<int>(phase)];
+        }
+        return computeStats(values, count);
+    }
+
+    /**
+     * @brief Get the min, average and 99th percentile of a counter over
+     * the kept frames
+     * 
+     * @param counter 
+     * @return Stats per frame, all 0 if no frame was profiled
+     */
+    Stats getCounterStats(ProfileCounter counter) const {
+        float values[HISTORY];
+        for (int i = 0; i < count; i ++) {
+            values[i] = counterSamples[i][static_cast<int>(counter)];
+        }
+        return computeStats(values, count);
+    }
+
+    /**
+     * @brief Get the name of a phase
+     * 
+     * @param phase 
+     * @return const char* 
+     */
+    static const char* getPhaseName(ProfilePhase phase) {
+        static const char* names[NUM_PHASES] = {"events", "input", "update", "clear", "render", "renderBuffer", "present", "frame"};
+        return names[static_cast<int>(phase)];
+    }
+
+    /**
+     * @brief Get the name of a counter
+     * 
+     * @param counter 
+     * @return const char* 
+     */
+    static const char* getCounterName(ProfileCounter counter) {
+        static const char* names[NUM_COUNTERS] = {"heapAllocs", "arenaAllocs", "arenaBytes"};
+        return names[static_cast<int>(counter)];
+    }
+
+private:
+    /**
+     * @brief the min, average and 99th percentile of values
+     * 
+     * @param values reordered
+     * @param count 
+     * @return Stats 
+     */
+    static Stats computeStats(float* values, int count) {
+        if (count == 0) {
+            return {0.0, 0.0, 0.0};
+        }
+        double sum = 0.0;
+        for (int i = 0; i < count; i ++) {
+            sum += values[i];
+        }
+        int rank = std::max(0, (count * 99 + 99) / 100 - 1);
+        std::nth_element(values, values + rank, values + count);
+        double p99 = values[rank];
+        return {*std::min_element(values, values + count), sum / count, p99};
+    }
+};
+
+/**
+ * @brief A bump allocator for memory that lives for one frame. Memory is
+ * handed out from a block by moving an offset, deallocate does nothing,
+ * and reset frees everything at once. When a frame overflows the block,
+ * more blocks are taken from the heap, and the next reset replaces them
+ * with a single block as large as all of them, so a steady workload
+ * stops allocating after its first frames. Not thread-safe.
+ * 
+ */
+class FrameArena : public std::pmr::memory_resource {
+    std::vector<std::unique_ptr<Uint8[]>> blocks;
+    std::vector<size_t> blockSizes;
+    size_t offset;      // the used bytes of the last block
+    size_t capacity;    // the bytes of all blocks
+    size_t bytesUsed;   // bytes handed out since the last reset, padding included
+    size_t allocations;     // allocations since the last reset
+    size_t blockAllocations;    // blocks taken from the heap since the arena was created
+
+public:
+    /**
+     * @brief Construct a new Frame Arena
+     * 
+     * @param initialSize the size of the first block, taken on first use
+     */
+    FrameArena(size_t initialSize = 64 * 1024) : offset{0}, capacity{0}, bytesUsed{0}, allocations{0}, blockAllocations{0} {
+        blockSizes.push_back(initialSize);
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * @brief frees everything allocated since the last reset, merging
+     * the blocks into one if there are several
+     * 
+     */
+    void reset() {
+        if (blocks.size() > 1) {
+            size_t total = capacity;
+            blocks.clear();
+            blockSizes.clear();
+            blockSizes.push_back(total);
+            capacity = 0;
+        }
+        offset = 0;
+        bytesUsed = 0;
+        allocations = 0;
+    }
+
+    /**
+     * @brief Get the number of allocations since the last reset
+     * 
+     * @return size_t 
+     */
+    size_t getAllocationCount() const {
+        return allocations;
+    }
+
+    /**
+     * @brief Get the bytes allocated since the last reset
+     * 
+     * @return size_t 
+     */
+    size_t getBytesUsed() const {
+        return bytesUsed;
+    }
+
+    /**
+     * @brief Get the number of blocks taken from the heap
+     * 
+     * @return size_t 
+     */
+    size_t getBlockAllocations() const {
+        return blockAllocations;
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        if (blocks.empty() || alignUp(offset, alignment) + bytes > blockSizes.back()) {
+            // the first block, or one twice as large as the last
+            size_t size = std::max(blocks.empty() ? blockSizes.back() : blockSizes.back() * 2, bytes + alignment);
+            if (blocks.empty()) {
+                blockSizes.back() = size;
+            } else {
+                blockSizes.push_back(size);
+            }
+            blocks.emplace_back(new Uint8[size]);
+            blockAllocations ++;
+            capacity += size;
+            offset = 0;
+        }
+        size_t start = alignUp(offset, alignment);
+        bytesUsed += start + bytes - offset;
+        offset = start + bytes;
+        allocations ++;
+        return blocks.back().get() + start;
+    }
+
+    /**
+     * @brief the first offset of the last block at or after offset whose
+     * address is a multiple of alignment
+     * 
+     */
+    size_t alignUp(size_t offset, size_t alignment) const {
+        uintptr_t address = reinterpret_cast<uintptr_t>(blocks.back().get()) + offset;
+        return offset + (alignment - address % alignment) % alignment;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+/**
+ * @brief An input received from SDL, in the order it arrived
+ * 
+ */
+struct InputEvent {
+    enum class Type {
+        KeyDown,
+        KeyUp,
+        ButtonDown,
+        ButtonUp,
+        CursorMove
+    };
+
+    Type type;
+    Uint32 timestamp;   // milliseconds since SDL was initialized
+    SDL_Scancode scancode;  // the physical key of KeyDown and KeyUp
+    SDL_Keycode key;    // the key in the current layout of KeyDown and KeyUp
+    bool repeat;    // KeyDown sent by key repeat
+    int button;     // the cursor index of ButtonDown and ButtonUp, see getCursorState
+    int x;  // the cell under the cursor
+    int y;
+};
+
+/**
+ * @brief Records the SDL events consumed by the game loop and the delta
+ * time of every frame to a binary "RCER" file, and reads them back for
+ * replay. Only the events the engine handles are kept, each in a few
+ * bytes: a tag, the timestamp and the fields the engine reads.
+ * 
+ */
+class InputLog {
+    enum Tag : Uint8 {
+        FRAME,  // followed by the delta time of the frame
+        QUIT,
+        KEY_DOWN,
+        KEY_UP,
+        MOTION,
+        BUTTON_DOWN,
+        BUTTON_UP
+    };
+
+    static constexpr Uint32 VERSION = 1;
+
+    FILE* file;
+    bool replaying;
+    int nextTag;    // the tag read after the events of the last replayed frame, EOF at the end
+
+public:
+    InputLog() : file{nullptr}, replaying{false}, nextTag{EOF} {}
+
+    InputLog(const InputLog&) = delete;
+    InputLog& operator=(const InputLog&) = delete;
+
+    ~InputLog() {
+        close();
+    }
+
+    /**
+     * @brief starts recording to a file
+     * 
+     * @param path 
+     * @param cellWidth the width of a cell, mouse positions are in pixels
+     * @param cellHeight the height of a cell
+     * @return true if the file was created
+     */
+    bool record(const std::string& path, int cellWidth, int cellHeight) {
+        close();
+        file = fopen(path.c_str(), "wb");
+        Uint32 header[3] = {VERSION, static_cast<Uint32>(cellWidth), static_cast<Uint32>(cellHeight)};
+        if (!file || fwrite("RCER", 1, 4, file) != 4 || fwrite(header, sizeof(header), 1, file) != 1) {
+            std::cerr << "Failed to create input recording " << path << std::endl;
+            close();
+            return false;
+        }
+        replaying = false;
+        return true;
+    }
+
+    /**
+     * @brief starts replaying a file written by record
+     * 
+     * @param path 
+     * @param cellWidth must match the recording
+     * @param cellHeight must match the recording
+     * @return true if the file is a recording with the same cell size
+     */
+    bool replay(const std::string& path, int cellWidth, int cellHeight) {
+        close();
+        file = fopen(path.c_str(), "rb");
+        if (!file) {
+            std::cerr << "Failed to open input recording " << path << std::endl;
+            return false;
+        }
+        char magic[4];
+        Uint32 header[3];
+        if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "RCER", 4) != 0
+            || fread(header, sizeof(header), 1, file) != 1 || header[0] != VERSION) {
+            std::cerr << "Invalid input recording " << path << std::endl;
+            close();
+            return false;
+        }
+        if (header[1] != static_cast<Uint32>(cellWidth) || header[2] != static_cast<Uint32>(cellHeight)) {
+            std::cerr << "Input recording " << path << " was made with " << header[1] << "x" << header[2] << " cells" << std::endl;
+            close();
+            return false;
+        }
+        replaying = true;
+        nextTag = fgetc(file);
+        return true;
+    }
+
+    /**
+     * @brief stops recording or replaying, flushing the recording
+     * 
+     */
+    void close() {
+        if (file) {
+            fclose(file);
+            file = nullptr;
+        }
+        replaying = false;
+    }
+
+    bool isRecording() const {
+        return file && !replaying;
+    }
+
+    bool isReplaying() const {
+        return file && replaying;
+    }
+
+    /**
+     * @brief starts the record of a frame
+     * 
+     * @param deltaTime the delta time the frame runs with
+     */
+    void beginFrame(double deltaTime) {
+        put(FRAME);
+        put(deltaTime);
+    }
+
+    /**
+     * @brief appends an event to the current frame, ignoring the
+     * events the engine does not handle
+     * 
+     * @param event 
+     */
+    void recordEvent(const SDL_Event& event) {
+        switch (event.type) {
+            case SDL_QUIT: {
+                put(QUIT);
+                put(event.common.timestamp);
+                break;
+            }
+            case SDL_KEYDOWN:
+            case SDL_KEYUP: {
+                put(event.type == SDL_KEYDOWN ? KEY_DOWN : KEY_UP);
+                put(event.key.timestamp);
+                put(static_cast<Uint16>(event.key.keysym.scancode));
+                put(event.key.keysym.sym);
+                put(event.key.keysym.mod);
+                put(event.key.repeat);
+                break;
+            }
+            case SDL_MOUSEMOTION: {
+                put(MOTION);
+                put(event.motion.timestamp);
+                put(event.motion.x);
+                put(event.motion.y);
+                break;
+            }
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP: {
+                put(event.type == SDL_MOUSEBUTTONDOWN ? BUTTON_DOWN : BUTTON_UP);
+                put(event.button.timestamp);
+                put(event.button.button);
+                put(event.button.clicks);
+                put(event.button.x);
+                put(event.button.y);
+                break;
+            }
+        }
+    }
+
+    /**
+     * @brief reads the next recorded frame
+     * 
+     * @param deltaTime set to the delta time of the frame
+     * @param events set to the events of the frame
+     * @return false at the end of the recording
+     */
+    bool readFrame(double& deltaTime, std::vector<SDL_Event>& events) {
+        events.clear();
+        if (nextTag != FRAME || !get(deltaTime)) {
+            return false;
+        }
+        bool valid = true;
+        while (valid && (nextTag = fgetc(file)) != EOF && nextTag != FRAME) {
+            SDL_Event event;
+            memset(&event, 0, sizeof(event));
+            switch (nextTag) {
+                case QUIT: {
+                    event.type = SDL_QUIT;
+                    valid = get(event.common.timestamp);
+                    break;
+                }
+                case KEY_DOWN:
+                case KEY_UP: {
+                    Uint16 scancode;
+                    event.type = nextTag == KEY_DOWN ? SDL_KEYDOWN : SDL_KEYUP;
+                    event.key.state = nextTag == KEY_DOWN ? SDL_PRESSED : SDL_RELEASED;
+                    valid = get(event.key.timestamp) && get(scancode) && get(event.key.keysym.sym)
+                        && get(event.key.keysym.mod) && get(event.key.repeat);
+                    event.key.keysym.scancode = static_cast<SDL_Scancode>(scancode);
+                    break;
+                }
+                case MOTION: {
+                    event.type = SDL_MOUSEMOTION;
+                    valid = get(event.motion.timestamp) && get(event.motion.x) && get(event.motion.y);
+                    break;
+                }
+                case BUTTON_DOWN:
+                case BUTTON_UP: {
+                    event.type = nextTag == BUTTON_DOWN ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+                    event.button.state = nextTag == BUTTON_DOWN ? SDL_PRESSED : SDL_RELEASED;
+                    valid = get(event.button.timestamp) && get(event.button.button) && get(event.button.clicks)
+                        && get(event.button.x) && get(event.button.y);
+                    break;
+                }
+                default: {
+                    valid = false;
+                }
+            }
+            if (valid) {
+                events.push_back(event);
+            }
+        }
+        if (!valid) {
+            std::cerr << "Input recording is truncated or corrupt" << std::endl;
+            nextTag = EOF;
+        }
+        return true;
+    }
+
+private:
+    template <typename T>
+    void put(T value) {
+        fwrite(&value, sizeof(value), 1, file);
+    }
+
+    template <typename T>
+    bool get(T& value) {
+        return fread(&value, sizeof(value), 1, file) == 1;
+    }
+};
+
+/**
+ * @brief Rasterizes the glyphs of a TTF font on demand into atlas
+ * pages divided into glyph-sized slots. When every page is full, the
+ * glyph least recently used before the current frame gives its slot
+ * away. Without a renderer the pages are coverage masks in memory, for
+ * the software backend.
+ * 
+ */
+class GlyphCache {
+public:
+    /**
+     * @brief where a glyph lies in the atlas
+     * 
+     */
+    struct Glyph {
+        int page;
+        SDL_Rect rect;  // in pixels of the page
+    };
+
+private:
+    struct Entry {
+        Glyph glyph;    // page is -1 when the font lacks the glyph
+        long lastUsed;  // the frame that last used the glyph
+    };
+
+    SDL_Renderer* renderer;
+    TTF_Font* font;
+    int glyphWidth;
+    int glyphHeight;
+    int pageSize;   // width and height of a page
+    int maxPages;
+    int slotsPerRow;
+    int slotsPerPage;
+    std::vector<SDL_Texture*> pages;
+    std::vector<std::vector<Uint8>> maskPages;  // the pages as 8-bit coverage when there is no renderer
+    std::unordered_map<Uint32, Entry> entries;  // keyed by code point
+    int usedSlots;  // slots handed out, evictions reuse slots instead
+    SDL_Surface* slotSurface;   // a glyph being uploaded
+    long frame;
+
+public:
+    /**
+     * @brief Construct a new Glyph Cache
+     * 
+     * @param renderer the renderer owning the pages, nullptr to keep
+     * them as coverage masks
+     * @param font 
+     * @param glyphWidth width of a slot
+     * @param glyphHeight height of a slot
+     * @param pageSize width and height of a page, reduced to the largest
+     * texture of the renderer
+     * @param maxPages pages created at most
+     */
+    GlyphCache(SDL_Renderer* renderer, TTF_Font* font, int glyphWidth, int glyphHeight, int pageSize = 1024, int maxPages = 4)
+        : renderer{renderer}, font{font}, glyphWidth{glyphWidth}, glyphHeight{glyphHeight}, pageSize{pageSize},
+        maxPages{maxPages}, usedSlots{0}, frame{0} {
+        SDL_RendererInfo info;
+        if (renderer && SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0) {
+            this->pageSize = std::min({pageSize, info.max_texture_width, info.max_texture_height});
+        }
+        slotsPerRow = std::max(this->pageSize / glyphWidth, 1);
+        slotsPerPage = slotsPerRow * std::max(this->pageSize / glyphHeight, 1);
+        slotSurface = SDL_CreateRGBSurfaceWithFormat(0, glyphWidth, glyphHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+    }
+
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    ~GlyphCache() {
+        for (SDL_Texture* page : pages) {
+            SDL_DestroyTexture(page);
+        }
+        if (slotSurface) {
+            SDL_FreeSurface(slotSurface);
+        }
+    }
+
+    /**
+     * @brief starts a frame, glyphs found during it are not evicted
+     * until the next frame
+     * 
+     */
+    void beginFrame() {
+        frame ++;
+    }
+
+    /**
+     * @brief Get a glyph, rasterizing it if it is not in the atlas
+     * 
+     * @param codePoint 
+     * @return const Glyph* nullptr if the font lacks the glyph or every
+     * slot holds a glyph of this frame
+     */
+    const Glyph* find(Uint32 codePoint) {
+        auto found = entries.find(codePoint);
+        if (found != entries.end()) {
+            found->second.lastUsed = frame;
+            return found->second.glyph.page >= 0 ? &found->second.glyph : nullptr;
+        }
+        SDL_Surface* surface = nullptr;
+#if SDL_TTF_VERSION_ATLEAST(2, 0, 18)
+        if (TTF_GlyphIsProvided32(font, codePoint)) {
+            surface = TTF_RenderGlyph32_Blended(font, codePoint, {255, 255, 255, 255});
+        }
+#else
+        if (codePoint <= 0xFFFF && TTF_GlyphIsProvided(font, static_cast<Uint16>(codePoint))) {
+            surface = TTF_RenderGlyph_Blended(font, static_cast<Uint16>(codePoint), {255, 255, 255, 255});
+        }
+#endif
+        Glyph glyph = {-1, {0, 0, 0, 0}};
+        if (surface && slotSurface && allocate(glyph)) {
+            upload(surface, glyph);
+        }
+        if (surface) {
+            SDL_FreeSurface(surface);
+        }
+        if (glyph.page < 0 && surface) {
+            // out of slots for now, try again next time
+            return nullptr;
+        }
+        Entry& entry = entries[codePoint];
+        entry.glyph = glyph;
+        entry.lastUsed = frame;
+        return glyph.page >= 0 ? &entry.glyph : nullptr;
+    }
+
+    /**
+     * @brief Get the texture of a page
+     * 
+     * @param page 
+     * @return SDL_Texture* 
+     */
+    SDL_Texture* getPage(int page) const {
+        return pages[page];
+    }
+
+    /**
+     * @brief Get the coverage of a glyph when the pages are masks, a
+     * row of the glyph is getPageSize() bytes after the previous one
+     * 
+     * @param glyph 
+     * @return const Uint8* 
+     */
+    const Uint8* getMask(const Glyph& glyph) const {
+        return maskPages[glyph.page].data() + glyph.rect.y * pageSize + glyph.rect.x;
+    }
+
+    int getPageCount() const {
+        return static_cast<int>(renderer ? pages.size() : maskPages.size());
+    }
+
+    int getPageSize() const {
+        return pageSize;
+    }
+
+    /**
+     * @brief Get the number of glyphs in the atlas
+     * 
+     * @return int 
+     */
+    int getGlyphCount() const {
+        int count = 0;
+        for (auto& entry : entries) {
+            count += entry.second.glyph.page >= 0;
+        }
+        return count;
+    }
+
+private:
+    /**
+     * @brief finds a free slot, creating a page or evicting the least
+     * recently used glyph if needed
+     * 
+     * @param glyph set to the slot
+     * @return true if a slot was found
+     */
+    bool allocate(Glyph& glyph) {
+        int slot = -1;
+        if (usedSlots < getPageCount() * slotsPerPage) {
+            slot = usedSlots ++;
+        } else if (!renderer && getPageCount() < maxPages) {
+            maskPages.emplace_back(static_cast<size_t>(pageSize) * pageSize);
+            slot = usedSlots ++;
+        } else if (getPageCount() < maxPages) {
+            SDL_Texture* page = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, pageSize, pageSize);
+            if (page) {
+                SDL_SetTextureBlendMode(page, SDL_BLENDMODE_BLEND);
+                pages.push_back(page);
+                slot = usedSlots ++;
+            }
+        }
+        if (slot >= 0) {
+            glyph.page = slot / slotsPerPage;
+            slot %= slotsPerPage;
+            glyph.rect = {(slot % slotsPerRow) * glyphWidth, (slot / slotsPerRow) * glyphHeight, glyphWidth, glyphHeight};
+            return true;
+        }
+        auto oldest = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++ it) {
+            if (it->second.glyph.page >= 0 && it->second.lastUsed < frame
+                && (oldest == entries.end() || it->second.lastUsed < oldest->second.lastUsed)) {
+                oldest = it;
+            }
+        }
+        if (oldest == entries.end()) {
+            return false;
+        }
+        glyph = oldest->second.glyph;
+        entries.erase(oldest);
+        return true;
+    }
+
+    /**
+     * @brief copies a rasterized glyph into its slot, centered and
+     * scaled down if it does not fit
+     * 
+     * @param surface 
+     * @param glyph 
+     */
+    void upload(SDL_Surface* surface, const Glyph& glyph) {
+        SDL_FillRect(slotSurface, nullptr, 0);
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+        SDL_Rect dest = {(glyphWidth - surface->w) / 2, (glyphHeight - surface->h) / 2, surface->w, surface->h};
+        if (surface->w <= glyphWidth && surface->h <= glyphHeight) {
+            SDL_BlitSurface(surface, nullptr, slotSurface, &dest);
+        } else {
+            double scale = std::min(static_cast<double>(glyphWidth) / surface->w, static_cast<double>(glyphHeight) / surface->h);
+            dest.w = std::max(static_cast<int>(surface->w * scale), 1);
+            dest.h = std::max(static_cast<int>(surface->h * scale), 1);
+            dest.x = (glyphWidth - dest.w) / 2;
+            dest.y = (glyphHeight - dest.h) / 2;
+            SDL_BlitScaled(surface, nullptr, slotSurface, &dest);
+        }
+        if (renderer) {
+            SDL_UpdateTexture(pages[glyph.page], &glyph.rect, slotSurface->pixels, slotSurface->pitch);
+            return;
+        }
+        Uint8* mask = maskPages[glyph.page].data() + glyph.rect.y * pageSize + glyph.rect.x;
+        for (int y = 0; y < glyphHeight; y ++) {
+            const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(slotSurface->pixels) + y * slotSurface->pitch);
+            for (int x = 0; x < glyphWidth; x ++) {
+                mask[y * pageSize + x] = static_cast<Uint8>(row[x] >> 24);
+            }
+        }
+    }
+};
+
+/**
+ * @brief The content of a cell
+ * 
+ */
+struct Cell {
+    Uint32 ch;      // code point
+    SDL_Color foreColor;
+    SDL_Color backColor;
+};
+
+/**
+ * @brief A large map of cells split into square chunks that are loaded
+ * on first use and unloaded when more than maxChunks are loaded. The
+ * camera selects the part drawn by RCEngine::drawTileMap; the cells
+ * last drawn are kept, and scrolling shifts them and only fetches the
+ * cells that came into view.
+ * 
+ */
+class TileMap {
+public:
+    static constexpr int CHUNK_SIZE = 32;   // rows and columns of a chunk
+
+    // fills a chunk, given as the chunk coordinates and its cells, which start as blank tiles
+    using ChunkLoader = std::function<void(int chunkX, int chunkY, CellBuffer& chunk)>;
+    // called before a chunk changed by setTile is unloaded
+    using ChunkSaver = std::function<void(int chunkX, int chunkY, const CellBuffer& chunk)>;
+
+private:
+    struct Chunk {
+        CellBuffer cells;
+        long lastUsed;  // the view update that last used the chunk
+        bool modified;  // changed by setTile since it was loaded
+        bool opaque;    // every color of the chunk is opaque
+    };
+
+    int rows;   // rows of tiles of the map
+    int cols;   // columns of tiles of the map
+    ChunkLoader loader;
+    ChunkSaver saver;
+    size_t maxChunks;
+    std::unordered_map<Uint64, Chunk> chunks;   // keyed by keyOf
+    long useCount;
+
+    int cameraX;    // the tile at the top-left corner of the view
+    int cameraY;
+    CellBuffer view;    // the cells last drawn
+    int viewX;  // the camera of view
+    int viewY;
+    bool viewValid;
+    bool viewOpaque;    // every chunk under view, and so every color of view, is opaque
+
+public:
+    /**
+     * @brief Construct a new Tile Map
+     * 
+     * @param rows rows of tiles
+     * @param cols columns of tiles
+     * @param loader fills the chunks when they are first used
+     * @param maxChunks chunks kept loaded, more are loaded only while
+     * the view needs them
+     */
+    TileMap(int rows, int cols, ChunkLoader loader, size_t maxChunks = 256)
+        : rows{rows}, cols{cols}, loader{loader}, maxChunks{maxChunks}, useCount{0}, cameraX{0}, cameraY{0},
+        viewX{0}, viewY{0}, viewValid{false}, viewOpaque{true} {}
+
+    /**
+     * @brief Set the function saving the chunks changed by setTile
+     * before they are unloaded
+     * 
+     * @param saver 
+     */
+    void setSaver(ChunkSaver saver) {
+        this->saver = saver;
+    }
+
+    int getRows() const {
+        return rows;
+    }
+
+    int getCols() const {
+        return cols;
+    }
+
+    /**
+     * @brief moves the camera
+     * 
+     * @param x the column of the map at the left of the view
+     * @param y the row of the map at the top of the view
+     */
+    void setCamera(int x, int y) {
+        cameraX = x;
+        cameraY = y;
+    }
+
+    int getCameraX() const {
+        return cameraX;
+    }
+
+    int getCameraY() const {
+        return cameraY;
+    }
+
+    /**
+     * @brief Get the number of chunks loaded
+     * 
+     * @return size_t 
+     */
+    size_t getLoadedChunks() const {
+        return chunks.size();
+    }
+
+    /**
+     * @brief Get a tile, loading its chunk if needed
+     * 
+     * @param x the column of the map
+     * @param y the row of the map
+     * @return Cell a blank tile outside the map
+     */
+    Cell getTile(int x, int y) {
+        if (x < 0 || x >= cols || y < 0 || y >= rows) {
+            return {' ', {255, 255, 255, 255}, {0, 0, 0, 255}};
+        }
+        Chunk& chunk = getChunk(floorDiv(x), floorDiv(y));
+        int index = chunk.cells.index(x - floorDiv(x) * CHUNK_SIZE, y - floorDiv(y) * CHUNK_SIZE);
+        return {chunk.cells.chs()[index], chunk.cells.foreColors()[index], chunk.cells.backColors()[index]};
+    }
+
+    /**
+     * @brief Set a tile, loading its chunk if needed
+     * 
+     * @param x the column of the map
+     * @param y the row of the map
+     * @param tile 
+     */
+    void setTile(int x, int y, Cell tile) {
+        if (x < 0 || x >= cols || y < 0 || y >= rows) {
+            return;
+        }
+        Chunk& chunk = getChunk(floorDiv(x), floorDiv(y));
+        int index = chunk.cells.index(x - floorDiv(x) * CHUNK_SIZE, y - floorDiv(y) * CHUNK_SIZE);
+        chunk.cells.chs()[index] = tile.ch;
+        chunk.cells.foreColors()[index] = tile.foreColor;
+        chunk.cells.backColors()[index] = tile.backColor;
+        chunk.modified = true;
+        bool opaque = tile.foreColor.a == 255 && tile.backColor.a == 255;
+        chunk.opaque = chunk.opaque && opaque;
+        if (viewValid && viewX <= x && x < viewX + view.getCols() && viewY <= y && y < viewY + view.getRows()) {
+            index = view.index(x - viewX, y - viewY);
+            view.chs()[index] = tile.ch;
+            view.foreColors()[index] = tile.foreColor;
+            view.backColors()[index] = tile.backColor;
+            viewOpaque = viewOpaque && opaque;
+        }
+    }
+
+    /**
+     * @brief Get the cells under the camera, updating only the cells
+     * that scrolled into view since the last call
+     * 
+     * @param viewRows rows of the view
+     * @param viewCols columns of the view
+     * @return const CellBuffer& 
+     */
+    const CellBuffer& getView(int viewRows, int viewCols) {
+        useCount ++;
+        int dx = cameraX - viewX;
+        int dy = cameraY - viewY;
+        if (!viewValid || view.getRows() != viewRows || view.getCols() != viewCols
+            || abs(dx) >= viewCols || abs(dy) >= viewRows) {
+            view.resize(viewRows, viewCols);
+            viewX = cameraX;
+            viewY = cameraY;
+            fetch({0, 0, viewCols, viewRows});
+            viewOpaque = isUnderViewOpaque();
+            viewValid = true;
+            return view;
+        }
+        if (dx != 0 || dy != 0) {
+            shiftView(dx, dy);
+            viewX = cameraX;
+            viewY = cameraY;
+            // the columns and rows that came into view
+            if (dx > 0) {
+                fetch({viewCols - dx, 0, dx, viewRows});
+            } else if (dx < 0) {
+                fetch({0, 0, -dx, viewRows});
+            }
+            if (dy > 0) {
+                fetch({0, viewRows - dy, viewCols, dy});
+            } else if (dy < 0) {
+                fetch({0, 0, viewCols, -dy});
+            }
+            // translucent chunks may have scrolled out
+            viewOpaque = isUnderViewOpaque();
+        } else {
+            touchView();
+        }
+        return view;
+    }
+
+    /**
+     * @brief Check whether every color of the last view is opaque
+     * 
+     * @return true if the view can be copied instead of blended
+     */
+    bool isViewOpaque() const {
+        return viewOpaque;
+    }
+
+private:
+    static int floorDiv(int n) {
+        return n >= 0 ? n / CHUNK_SIZE : (n - CHUNK_SIZE + 1) / CHUNK_SIZE;
+    }
+
+    static Uint64 keyOf(int chunkX, int chunkY) {
+        return (static_cast<Uint64>(static_cast<Uint32>(chunkY)) << 32) | static_cast<Uint32>(chunkX);
+    }
+
+    /**
+     * @brief Get a chunk, loading it and unloading the least recently
+     * used chunk if needed
+     * 
+     * @param chunkX 
+     * @param chunkY 
+     * @return Chunk& 
+     */
+    Chunk& getChunk(int chunkX, int chunkY) {
+        auto found = chunks.find(keyOf(chunkX, chunkY));
+        if (found != chunks.end()) {
+            found->second.lastUsed = useCount;
+            return found->second;
+        }
+        if (chunks.size() >= maxChunks) {
+            unloadOldest();
+        }
+        Chunk& chunk = chunks[keyOf(chunkX, chunkY)];
+        chunk.cells.resize(CHUNK_SIZE, CHUNK_SIZE);
+        chunk.cells.clear(' ', {255, 255, 255, 255}, {0, 0, 0, 255});
+        if (loader) {
+            loader(chunkX, chunkY, chunk.cells);
+        }
+        chunk.lastUsed = useCount;
+        chunk.modified = false;
+        chunk.opaque = true;
+        for (int i = 0; i < chunk.cells.size() && chunk.opaque; i ++) {
+            chunk.opaque = chunk.cells.foreColors()[i].a == 255 && chunk.cells.backColors()[i].a == 255;
+        }
+        return chunk;
+    }
+
+    /**
+     * @brief unloads the least recently used chunk, unless the current
+     * view update uses every loaded chunk
+     * 
+     */
+    void unloadOldest() {
+        auto oldest = chunks.end();
+        for (auto it = chunks.begin(); it != chunks.end(); ++ it) {
+            if (it->second.lastUsed < useCount && (oldest == chunks.end() || it->second.lastUsed < oldest->second.lastUsed)) {
+                oldest = it;
+            }
+        }
+        if (oldest == chunks.end()) {
+            return;
+        }
+        if (oldest->second.modified && saver) {
+            saver(static_cast<Sint32>(oldest->first & 0xFFFFFFFF), static_cast<Sint32>(oldest->first >> 32), oldest->second.cells);
+        }
+        chunks.erase(oldest);
+    }
+
+    /**
+     * @brief marks the chunks under the view as used, so they are not
+     * the ones unloaded
+     * 
+     */
+    void touchView() {
+        for (int chunkY = floorDiv(viewY); chunkY <= floorDiv(viewY + view.getRows() - 1); chunkY ++) {
+            for (int chunkX = floorDiv(viewX); chunkX <= floorDiv(viewX + view.getCols() - 1); chunkX ++) {
+                auto found = chunks.find(keyOf(chunkX, chunkY));
+                if (found != chunks.end()) {
+                    found->second.lastUsed = useCount;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Check whether the chunks under the view are opaque, the
+     * tiles outside the map are
+     * 
+     * @return false also if one of them was unloaded, when maxChunks
+     * cannot hold the view
+     */
+    bool isUnderViewOpaque() const {
+        int mapLeft = std::max(viewX, 0);
+        int mapTop = std::max(viewY, 0);
+        int mapRight = std::min(viewX + view.getCols(), cols);
+        int mapBottom = std::min(viewY + view.getRows(), rows);
+        if (mapRight <= mapLeft || mapBottom <= mapTop) {
+            return true;
+        }
+        for (int chunkY = floorDiv(mapTop); chunkY <= floorDiv(mapBottom - 1); chunkY ++) {
+            for (int chunkX = floorDiv(mapLeft); chunkX <= floorDiv(mapRight - 1); chunkX ++) {
+                auto found = chunks.find(keyOf(chunkX, chunkY));
+                if (found == chunks.end() || !found->second.opaque) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief moves the cells of view by (-dx, -dy), the cells that stay
+     * in view are not fetched again
+     * 
+     * @param dx 
+     * @param dy 
+     */
+    void shiftView(int dx, int dy) {
+        touchView();
+        int width = view.getCols() - abs(dx);
+        int srcX = std::max(dx, 0);
+        int destX = std::max(-dx, 0);
+        // rows are visited so that no source row is overwritten before it is moved
+        int first = dy >= 0 ? 0 : view.getRows() - 1;
+        int last = dy >= 0 ? view.getRows() - dy : -dy - 1;
+        int step = dy >= 0 ? 1 : -1;
+        for (int y = first; y != last; y += step) {
+            int dest = view.index(destX, y);
+            int src = view.index(srcX, y + dy);
+            std::memmove(view.chs() + dest, view.chs() + src, width * sizeof(Uint32));
+            std::memmove(view.foreColors() + dest, view.foreColors() + src, width * sizeof(SDL_Color));
+            std::memmove(view.backColors() + dest, view.backColors() + src, width * sizeof(SDL_Color));
+        }
+    }
+
+    /**
+     * @brief copies the tiles of a rectangle of view from the chunks,
+     * visiting only the chunks under it
+     * 
+     * @param rect (x, y, w, h) in view coordinates
+     */
+    void fetch(SDL_Rect rect) {
+        int left = viewX + rect.x;
+        int top = viewY + rect.y;
+        int right = left + rect.w;
+        int bottom = top + rect.h;
+        // outside the map
+        view.clear(' ', {255, 255, 255, 255}, {0, 0, 0, 255}, rect);
+        int mapLeft = std::max(left, 0);
+        int mapTop = std::max(top, 0);
+        int mapRight = std::min(right, cols);
+        int mapBottom = std::min(bottom, rows);
+        if (mapRight <= mapLeft || mapBottom <= mapTop) {
+            return;
+        }
+        for (int chunkY = floorDiv(mapTop); chunkY <= floorDiv(mapBottom - 1); chunkY ++) {
+            for (int chunkX = floorDiv(mapLeft); chunkX <= floorDiv(mapRight - 1); chunkX ++) {
+                Chunk& chunk = getChunk(chunkX, chunkY);
+                int x0 = std::max(mapLeft, chunkX * CHUNK_SIZE);
+                int x1 = std::min(mapRight, (chunkX + 1) * CHUNK_SIZE);
+                int y0 = std::max(mapTop, chunkY * CHUNK_SIZE);
+                int y1 = std::min(mapBottom, (chunkY + 1) * CHUNK_SIZE);
+                for (int y = y0; y < y1; y ++) {
+                    int src = chunk.cells.index(x0 - chunkX * CHUNK_SIZE, y - chunkY * CHUNK_SIZE);
+                    int dest = view.index(x0 - viewX, y - viewY);
+                    std::memcpy(view.chs() + dest, chunk.cells.chs() + src, (x1 - x0) * sizeof(Uint32));
+                    std::memcpy(view.foreColors() + dest, chunk.cells.foreColors() + src, (x1 - x0) * sizeof(SDL_Color));
+                    std::memcpy(view.backColors() + dest, chunk.cells.backColors() + src, (x1 - x0) * sizeof(SDL_Color));
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief How drawParticles combines a particle with its cell
+ * 
+ */
+enum class ParticleBlend {
+    Alpha,      // blended over the cell like draw, in the order of the particles
+    Additive    // the color scaled by its alpha added to the cell, saturating
+};
+
+/**
+ * @brief Emits the particles of a ParticleSystem at a steady rate.
+ * Zero-initialize it with {} and set the fields used.
+ * 
+ */
+struct ParticleEmitter {
+    float x;    // the top-left corner of the area particles start in, in cells
+    float y;
+    float width;    // the size of the area, 0 for a point
+    float height;
+    float rate;     // particles emitted per second
+    float velocityX;    // the mean velocity, in cells per second
+    float velocityY;
+    float spreadX;  // a velocity uniform in [-spread, spread] is added to the mean
+    float spreadY;
+    float life;     // the mean lifetime, in seconds
+    float lifeSpread;   // a time uniform in [-lifeSpread, lifeSpread] is added to the lifetime
+    Uint32 ch;      // the character drawn, 0 to only color the background
+    SDL_Color color;
+    bool enabled;
+};
+
+/**
+ * @brief Particles stored as structure of arrays, one plane per
+ * attribute, so that update integrates them several at a time with
+ * SIMD. Dead particles are replaced by the last one, so the order of
+ * the particles changes. Emission uses its own seeded generator, so a
+ * replayed session emits the same particles.
+ * 
+ */
+class ParticleSystem {
+    int capacity;
+    int count;
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+    std::vector<float> ages;    // seconds since emission
+    std::vector<float> lives;   // lifetimes in seconds
+    std::vector<Uint32> chs;
+    std::vector<SDL_Color> colors;
+    std::vector<ParticleEmitter> emitters;
+    std::vector<float> emitterDebt;     // the fraction of a particle each emitter owes
+    Uint32 seed;
+
+public:
+    float gravityX;     // acceleration of every particle, in cells per second squared
+    float gravityY;
+    float drag;     // fraction of the velocity lost per second
+    bool fade;      // the alpha of a particle falls to 0 over its lifetime
+
+    /**
+     * @brief Construct a new Particle System
+     * 
+     * @param capacity the most particles alive at once, more are dropped
+     * @param seed seed of the emission generator
+     */
+    explicit ParticleSystem(int capacity = 100000, Uint32 seed = 1)
+        : capacity{capacity}, count{0}, seed{seed ? seed : 1}, gravityX{0.0f}, gravityY{0.0f}, drag{0.0f}, fade{true} {
+        posX.resize(capacity);
+        posY.resize(capacity);
+        velX.resize(capacity);
+        velY.resize(capacity);
+        ages.resize(capacity);
+        lives.resize(capacity);
+        chs.resize(capacity);
+        colors.resize(capacity);
+    }
+
+    /**
+     * @brief adds an emitter
+     * 
+     * @param emitter 
+     * @return int the id of the emitter
+     */
+    int addEmitter(const ParticleEmitter& emitter) {
+        emitters.push_back(emitter);
+        emitterDebt.push_back(0.0f);
+        return static_cast<int>(emitters.size()) - 1;
+    }
+
+    /**
+     * @brief Get an emitter to move or change it
+     * 
+     * @param id 
+     * @return ParticleEmitter& 
+     */
+    ParticleEmitter& getEmitter(int id) {
+        return emitters[id];
+    }
+
+    /**
+     * @brief emits a particle
+     * 
+     * @param x 
+     * @param y 
+     * @param velocityX in cells per second
+     * @param velocityY 
+     * @param life in seconds
+     * @param ch the character, 0 to only color the background
+     * @param color 
+     * @return false if the system is full
+     */
+    bool emit(float x, float y, float velocityX, float velocityY, float life, Uint32 ch, SDL_Color color) {
+        if (count == capacity) {
+            return false;
+        }
+        posX[count] = x;
+        posY[count] = y;
+        velX[count] = velocityX;
+        velY[count] = velocityY;
+        ages[count] = 0.0f;
+        lives[count] = life;
+        chs[count] = ch;
+        colors[count] = color;
+        count ++;
+        return true;
+    }
+
+    /**
+     * @brief emits particles from an emitter at once, such as sparks
+     * 
+     * @param emitter 
+     * @param particles the number of particles
+     */
+    void burst(const ParticleEmitter& emitter, int particles) {
+        for (int i = 0; i < particles && count < capacity; i ++) {
+            emit(emitter.x + emitter.width * random01(), emitter.y + emitter.height * random01(),
+                emitter.velocityX + emitter.spreadX * random11(), emitter.velocityY + emitter.spreadY * random11(),
+                emitter.life + emitter.lifeSpread * random11(), emitter.ch, emitter.color);
+        }
+    }
+
+    /**
+     * @brief moves the particles, removes those that died, and emits the
+     * particles of the emitters for this step
+     * 
+     * @param deltaTime seconds
+     * @param pool when given, the particles are moved in parallel on it
+     */
+    void update(double deltaTime, ThreadPool* pool = nullptr) {
+        float dt = static_cast<float>(deltaTime);
+        float damping = std::max(0.0f, 1.0f - drag * dt);
+        const int grain = 16384;
+        if (pool && count > grain) {
+            pool->parallelFor(count, grain, [&](int begin, int end) {
+                integrate(begin, end, dt, damping);
+            });
+        } else {
+            integrate(0, count, dt, damping);
+        }
+
+        for (int i = 0; i < count;) {
+#if defined(RCE_SSE2) || defined(RCE_AVX2)
+            // skip four particles at once while none of them died
+            if (i + 4 <= count && _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&ages[i]), _mm_loadu_ps(&lives[i]))) == 0) {
+                i += 4;
+                continue;
+            }
+#endif
+            if (ages[i] >= lives[i]) {
+                count --;
+                posX[i] = posX[count];
+                posY[i] = posY[count];
+                velX[i] = velX[count];
+                velY[i] = velY[count];
+                ages[i] = ages[count];
+                lives[i] = lives[count];
+                chs[i] = chs[count];
+                colors[i] = colors[count];
+            } else {
+                i ++;
+            }
+        }
+
+        for (size_t i = 0; i < emitters.size(); i ++) {
+            if (!emitters[i].enabled) {
+                continue;
+            }
+            emitterDebt[i] += emitters[i].rate * dt;
+            int particles = static_cast<int>(emitterDebt[i]);
+            emitterDebt[i] -= particles;
+            burst(emitters[i], particles);
+        }
+    }
+
+    /**
+     * @brief removes every particle
+     * 
+     */
+    void clear() {
+        count = 0;
+    }
+
+    /**
+     * @brief Get the number of live particles
+     * 
+     * @return int 
+     */
+    int size() const {
+        return count;
+    }
+
+    int getCapacity() const {
+        return capacity;
+    }
+
+    const float* getPositionsX() const {
+        return posX.data();
+    }
+
+    const float* getPositionsY() const {
+        return posY.data();
+    }
+
+    const float* getAges() const {
+        return ages.data();
+    }
+
+    const float* getLives() const {
+        return lives.data();
+    }
+
+    const Uint32* getChs() const {
+        return chs.data();
+    }
+
+    const SDL_Color* getColors() const {
+        return colors.data();
+    }
+
+private:
+    /**
+     * @brief advances particles [begin, end) by one step of semi-implicit
+     * Euler: the velocity first, then the position with the new velocity
+     * 
+     */
+    void integrate(int begin, int end, float dt, float damping) {
+        float* px = posX.data();
+        float* py = posY.data();
+        float* vx = velX.data();
+        float* vy = velY.data();
+        float* age = ages.data();
+        float ax = gravityX * dt;
+        float ay = gravityY * dt;
+        int i = begin;
+#if defined(RCE_AVX2)
+        const __m256 dt8 = _mm256_set1_ps(dt);
+        const __m256 damping8 = _mm256_set1_ps(damping);
+        const __m256 ax8 = _mm256_set1_ps(ax);
+        const __m256 ay8 = _mm256_set1_ps(ay);
+        for (; i + 8 <= end; i += 8) {
+            __m256 velocityX = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(vx + i), damping8), ax8);
+            __m256 velocityY = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(vy + i), damping8), ay8);
+            _mm256_storeu_ps(vx + i, velocityX);
+            _mm256_storeu_ps(vy + i, velocityY);
+            _mm256_storeu_ps(px + i, _mm256_add_ps(_mm256_loadu_ps(px + i), _mm256_mul_ps(velocityX, dt8)));
+            _mm256_storeu_ps(py + i, _mm256_add_ps(_mm256_loadu_ps(py + i), _mm256_mul_ps(velocityY, dt8)));
+            _mm256_storeu_ps(age + i, _mm256_add_ps(_mm256_loadu_ps(age + i), dt8));
+        }
+#elif defined(RCE_SSE2)
+        const __m128 dt4 = _mm_set1_ps(dt);
+        const __m128 damping4 = _mm_set1_ps(damping);
+        const __m128 ax4 = _mm_set1_ps(ax);
+        const __m128 ay4 = _mm_set1_ps(ay);
+        for (; i + 4 <= end; i += 4) {
+            __m128 velocityX = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vx + i), damping4), ax4);
+            __m128 velocityY = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vy + i), damping4), ay4);
+            _mm_storeu_ps(vx + i, velocityX);
+            _mm_storeu_ps(vy + i, velocityY);
+            _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(velocityX, dt4)));
+            _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(velocityY, dt4)));
+            _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt4));
+        }
+#endif
+        for (; i < end; i ++) {
+            vx[i] = vx[i] * damping + ax;
+            vy[i] = vy[i] * damping + ay;
+            px[i] += vx[i] * dt;
+            py[i] += vy[i] * dt;
+            age[i] += dt;
+        }
+    }
+
+    /**
+     * @brief the next number of the xorshift generator
+     * 
+     */
+    Uint32 nextRandom() {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+
+    /**
+     * @brief a random number in [0, 1)
+     * 
+     */
+    float random01() {
+        return (nextRandom() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    /**
+     * @brief a random number in [-1, 1)
+     * 
+     */
+    float random11() {
+        return random01() * 2.0f - 1.0f;
+    }
+};
+
+/**
+ * @brief The kinds of files loaded by an AssetManager
+ * 
+ */
+enum class AssetType {
+    Texture,    // an image, magenta keyed transparent, uploaded as a texture
+    Image,      // a CellImage in the "RCEI" format
+    Sound       // a Mix_Chunk
+};
+
+/**
+ * @brief The state of an asset
+ * 
+ */
+enum class AssetState {
+    Loading,    // queued or being decoded
+    Ready,
+    Failed      // the first load failed, or the handle is not valid
+};
+
+/**
+ * @brief Loads textures, cell images and sounds by path. Files are
+ * decoded on a background I/O thread and textures are uploaded on the
+ * main thread by update(), so loading never stalls a frame. Assets are
+ * shared by path and counted: acquire the same path twice and it is
+ * loaded once, and freed when the last handle is released. With a
+ * reload interval set, the I/O thread also checks the modification
+ * time and size of the loaded files and reloads the ones that changed.
+ * 
+ */
+class AssetManager {
+    struct Asset {
+        std::string path;
+        AssetType type;
+        AssetState state;
+        int refs;
+        int version;    // incremented every time the asset is (re)loaded
+        Uint64 serial;  // the serial of the last result taken, older ones are stale
+        SDL_Surface* surface;   // Texture: the decoded ARGB8888 pixels
+        SDL_Texture* texture;   // Texture: null without a renderer
+        CellImage image;
+        Mix_Chunk* sound;
+    };
+
+    struct Job {
+        int id;
+        Uint64 serial;  // orders the decodes of an asset
+        std::string path;
+        AssetType type;
+    };
+
+    struct Result {
+        int id;
+        Uint64 serial;
+        bool loaded;
+        SDL_Surface* surface;
+        CellImage image;
+        Mix_Chunk* sound;
+        std::string error;  // why the file could not be loaded
+    };
+
+    struct Watch {
+        int id;
+        std::string path;
+        AssetType type;
+        long long modified;     // -1 until the file is first loaded
+        long long size;
+    };
+
+    std::vector<std::unique_ptr<Asset>> assets;     // indexed by handle, released assets are null
+    std::unordered_map<std::string, int> handles;   // by type and path
+    SDL_Renderer* renderer;
+    int pending;    // assets still loading
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;   // signals the worker
+    std::deque<Job> jobs;
+    std::vector<Result> results;    // decoded by the worker, not yet taken by update
+    std::vector<Result> finished;   // swapped with results by update
+    std::vector<Watch> watches;     // the files checked for hot reload
+    std::vector<Watch> polled;      // the worker's copy of watches
+    Uint64 serial;  // the serial of the last decode started
+    double reloadInterval;
+    bool running;
+
+public:
+    AssetManager() : renderer{nullptr}, pending{0}, serial{0}, reloadInterval{0.0}, running{false} {}
+
+    ~AssetManager() {
+        clear();
+    }
+
+    /**
+     * @brief Set the renderer textures are uploaded to; without one,
+     * Texture assets only keep their surface
+     * 
+     * @param renderer 
+     */
+    void setRenderer(SDL_Renderer* renderer) {
+        this->renderer = renderer;
+    }
+
+    /**
+     * @brief Set how often the I/O thread checks the loaded files for
+     * changes
+     * 
+     * @param seconds 0 disables hot reload
+     */
+    void setReloadInterval(double seconds) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            reloadInterval = seconds;
+        }
+        wake.notify_one();
+    }
+
+    /**
+     * @brief queues a file to be loaded on the I/O thread, or takes
+     * another reference to it if it was already acquired
+     * 
+     * @param path the file to load
+     * @param type how to decode it
+     * @return int the handle of the asset, Loading until update takes
+     * the decoded file
+     */
+    int acquire(const std::string& path, AssetType type) {
+        int id = findAsset(path, type);
+        if (id >= 0) {
+            assets[id]->refs ++;
+            return id;
+        }
+        id = addAsset(path, type);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            startWorker();
+            jobs.push_back({id, ++ serial, path, type});
+        }
+        wake.notify_one();
+        return id;
+    }
+
+    /**
+     * @brief loads a file on the calling thread, or takes another
+     * reference to it if it was already acquired, for the few assets
+     * that are needed before anything can be drawn
+     * 
+     * @param path the file to load
+     * @param type how to decode it
+     * @return int the handle of the asset, Ready or Failed
+     */
+    int load(const std::string& path, AssetType type) {
+        int id = findAsset(path, type);
+        if (id >= 0) {
+            assets[id]->refs ++;
+            if (assets[id]->state != AssetState::Loading) {
+                return id;
+            }
+        } else {
+            id = addAsset(path, type);
+        }
+        Result result = {id, 0, false, nullptr, CellImage(), nullptr, {}};
+        {
+            // the queued decode is not needed, and one in progress is stale
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [id](const Job& job) { return job.id == id; }), jobs.end());
+            result.serial = ++ serial;
+        }
+        long long modified = -1;
+        long long size = 0;
+        readStamp(path, modified, size);
+        decode(path, type, result);
+        install(result);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            startWorker();
+            for (Watch& watch : watches) {
+                if (watch.id == id) {
+                    watch.modified = modified;
+                    watch.size = size;
+                }
+            }
+        }
+        return id;
+    }
+
+    /**
+     * @brief drops a reference to an asset, and frees it with the last
+     * one
+     * 
+     * @param id the handle of the asset
+     */
+    void release(int id) {
+        Asset* asset = getAsset(id);
+        if (!asset || -- asset->refs > 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [id](const Job& job) { return job.id == id; }), jobs.end());
+            watches.erase(std::remove_if(watches.begin(), watches.end(), [id](const Watch& watch) { return watch.id == id; }), watches.end());
+        }
+        if (asset->state == AssetState::Loading) {
+            pending --;
+        }
+        handles.erase(makeKey(asset->path, asset->type));
+        freeAsset(*asset);
+        assets[id].reset();
+    }
+
+    /**
+     * @brief takes the files decoded by the I/O thread: uploads the
+     * textures and replaces reloaded assets. Called by the engine on
+     * the main thread at the start of every frame.
+     * 
+     */
+    void update() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (results.empty()) {
+                return;
+            }
+            std::swap(results, finished);
+        }
+        for (Result& result : finished) {
+            install(result);
+        }
+        finished.clear();
+    }
+
+    /**
+     * @brief stops the I/O thread and frees every asset
+     * 
+     */
+    void clear() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        for (Result& result : results) {
+            freeResult(result);
+        }
+        results.clear();
+        jobs.clear();
+        watches.clear();
+        for (std::unique_ptr<Asset>& asset : assets) {
+            if (asset) {
+                freeAsset(*asset);
+            }
+        }
+        assets.clear();
+        handles.clear();
+        pending = 0;
+    }
+
+    /**
+     * @brief Get the state of an asset
+     * 
+     * @param id the handle of the asset
+     * @return AssetState Failed if the handle is not valid
+     */
+    AssetState getState(int id) const {
+        const Asset* asset = getAsset(id);
+        return asset ? asset->state : AssetState::Failed;
+    }
+
+    /**
+     * @brief Get how many times an asset was loaded, to notice reloads
+     * 
+     * @param id the handle of the asset
+     * @return int 0 while it is first loading
+     */
+    int getVersion(int id) const {
+        const Asset* asset = getAsset(id);
+        return asset ? asset->version : 0;
+    }
+
+    /**
+     * @brief Get the number of assets still loading
+     * 
+     * @return int 
+     */
+    int getPendingCount() const {
+        return pending;
+    }
+
+    /**
+     * @brief Get the texture of a Texture asset
+     * 
+     * @param id the handle of the asset
+     * @return SDL_Texture* null until it is Ready, or without a renderer
+     */
+    SDL_Texture* getTexture(int id) const {
+        const Asset* asset = getAsset(id);
+        return asset ? asset->texture : nullptr;
+    }
+
+    /**
+     * @brief Get the ARGB8888 pixels of a Texture asset, with the color
+     * key transparent
+     * 
+     * @param id the handle of the asset
+     * @return SDL_Surface* null until it is Ready
+     */
+    SDL_Surface* getSurface(int id) const {
+        const Asset* asset = getAsset(id);
+        return asset ? asset->surface : nullptr;
+    }
+
+    /**
+     * @brief Get the cell image of an Image asset
+     * 
+     * @param id the handle of the asset
+     * @return const CellImage* null until it is Ready
+     */
+    const CellImage* getImage(int id) const {
+        const Asset* asset = getAsset(id);
+        return asset && asset->type == AssetType::Image && asset->version > 0 ? &asset->image : nullptr;
+    }
+
+    /**
+     * @brief Get the chunk of a Sound asset
+     * 
+     * @param id the handle of the asset
+     * @return Mix_Chunk* null until it is Ready
+     */
+    Mix_Chunk* getSound(int id) const {
+        const Asset* asset = getAsset(id);
+        return asset ? asset->sound : nullptr;
+    }
+
+    /**
+     * @brief decodes an image file to ARGB8888 with the magenta color
+     * key made transparent, so that the texture made from it needs no
+     * color key. Safe to call off the main thread.
+     * 
+     * @param path the image file
+     * @return SDL_Surface* null if the file cannot be decoded
+     */
+    static SDL_Surface* decodeImage(const std::string& path) {
+        SDL_Surface* surface = IMG_Load(path.c_str());
+        if (!surface) {
+            return nullptr;
+        }
+        SDL_Surface* argb = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        if (!argb) {
+            return nullptr;
+        }
+        for (int y = 0; y < argb->h; y ++) {
+            Uint32* row = reinterpret_cast<Uint32*>(static_cast<Uint8*>(argb->pixels) + y * argb->pitch);
+            for (int x = 0; x < argb->w; x ++) {
+                if ((row[x] & 0xFFFFFF) == 0xFF00FF) {
+                    row[x] &= 0xFFFFFF;
+                }
+            }
+        }
+        return argb;
+    }
+
+private:
+    Asset* getAsset(int id) const {
+        return id >= 0 && id < static_cast<int>(assets.size()) ? assets[id].get() : nullptr;
+    }
+
+    static std::string makeKey(const std::string& path, AssetType type) {
+        return static_cast<char>('0' + static_cast<int>(type)) + path;
+    }
+
+    int findAsset(const std::string& path, AssetType type) const {
+        auto found = handles.find(makeKey(path, type));
+        return found == handles.end() ? -1 : found->second;
+    }
+
+    /**
+     * @brief adds a Loading asset with one reference and watches its file
+     * 
+     */
+    int addAsset(const std::string& path, AssetType type) {
+        int id = static_cast<int>(assets.size());
+        std::unique_ptr<Asset> asset(new Asset());
+        asset->path = path;
+        asset->type = type;
+        asset->state = AssetState::Loading;
+        asset->refs = 1;
+        asset->version = 0;
+        asset->serial = 0;
+        asset->surface = nullptr;
+        asset->texture = nullptr;
+        asset->sound = nullptr;
+        assets.push_back(std::move(asset));
+        handles[makeKey(path, type)] = id;
+        pending ++;
+        std::lock_guard<std::mutex> lock(mutex);
+        watches.push_back({id, path, type, -1, 0});
+        return id;
+    }
+
+    /**
+     * @brief replaces an asset with a decoded file on the main thread.
+     * A failed reload keeps the previous contents, and a result older
+     * than the one last taken is dropped.
+     * 
+     */
+    void install(Result& result) {
+        Asset* asset = getAsset(result.id);
+        if (asset && result.serial < asset->serial) {
+            asset = nullptr;
+        } else if (asset) {
+            asset->serial = result.serial;
+        }
+        SDL_Texture* texture = nullptr;
+        if (asset && result.loaded && asset->type == AssetType::Texture && renderer) {
+            texture = SDL_CreateTextureFromSurface(renderer, result.surface);
+            if (!texture) {
+                result.loaded = false;
+                result.error = SDL_GetError();
+            }
+        }
+        if (!asset || !result.loaded) {
+            if (asset) {
+                std::cerr << "Failed to load " << asset->path << ": " << result.error << std::endl;
+                if (asset->state == AssetState::Loading) {
+                    asset->state = AssetState::Failed;
+                    pending --;
+                }
+            }
+            freeResult(result);
+            return;
+        }
+        if (texture) {
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
+        freeAsset(*asset);
+        asset->surface = result.surface;
+        asset->texture = texture;
+        asset->image = std::move(result.image);
+        asset->sound = result.sound;
+        result.surface = nullptr;
+        result.sound = nullptr;
+        if (asset->state == AssetState::Loading) {
+            pending --;
+        }
+        asset->state = AssetState::Ready;
+        asset->version ++;
+    }
+
+    static void freeAsset(Asset& asset) {
+        if (asset.texture) {
+            SDL_DestroyTexture(asset.texture);
+            asset.texture = nullptr;
+        }
+        if (asset.surface) {
+            SDL_FreeSurface(asset.surface);
+            asset.surface = nullptr;
+        }
+        if (asset.sound) {
+            Mix_FreeChunk(asset.sound);
+            asset.sound = nullptr;
+        }
+    }
+
+    static void freeResult(Result& result) {
+        if (result.surface) {
+            SDL_FreeSurface(result.surface);
+            result.surface = nullptr;
+        }
+        if (result.sound) {
+            Mix_FreeChunk(result.sound);
+            result.sound = nullptr;
+        }
+    }
+
+    static void decode(const std::string& path, AssetType type, Result& result) {
+        if (type == AssetType::Texture) {
+            result.surface = decodeImage(path);
+            result.loaded = result.surface != nullptr;
+        } else if (type == AssetType::Image) {
+            // read, not mapped: the file may be rewritten and reloaded
+            result.loaded = result.image.load(path, false);
+        } else {
+            result.sound = Mix_LoadWAV(path.c_str());
+            result.loaded = result.sound != nullptr;
+        }
+        if (!result.loaded) {
+            // SDL errors are kept per thread
+            result.error = type == AssetType::Image ? "invalid cell image" : SDL_GetError();
+        }
+    }
+
+    /**
+     * @brief reads the modification time and size of a file, the time
+     * in nanoseconds where the platform records them
+     * 
+     * @return true if the file exists
+     */
+    static bool readStamp(const std::string& path, long long& modified, long long& size) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) {
+            return false;
+        }
+#if defined(__APPLE__)
+        modified = static_cast<long long>(info.st_mtimespec.tv_sec) * 1000000000LL + info.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+        modified = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+#else
+        modified = static_cast<long long>(info.st_mtime) * 1000000000LL;
+#endif
+        size = static_cast<long long>(info.st_size);
+        return true;
+    }
+
+    /**
+     * @brief starts the I/O thread, with the mutex held
+     * 
+     */
+    void startWorker() {
+        if (!running) {
+            running = true;
+            worker = std::thread(&AssetManager::run, this);
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        // a deadline, so that a steady stream of jobs does not put off the poll
+        auto nextPoll = std::chrono::steady_clock::now();
+        while (running) {
+            if (reloadInterval > 0.0 && std::chrono::steady_clock::now() >= nextPoll) {
+                poll(lock);
+                nextPoll = std::chrono::steady_clock::now()
+                    + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(reloadInterval));
+                continue;
+            }
+            if (jobs.empty()) {
+                if (reloadInterval <= 0.0) {
+                    wake.wait(lock);
+                } else {
+                    wake.wait_until(lock, nextPoll);
+                }
+                continue;
+            }
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+
+            long long modified = -1;
+            long long size = 0;
+            readStamp(job.path, modified, size);
+            Result result = {job.id, job.serial, false, nullptr, CellImage(), nullptr, {}};
+            decode(job.path, job.type, result);
+
+            lock.lock();
+            for (Watch& watch : watches) {
+                if (watch.id == job.id) {
+                    watch.modified = modified;
+                    watch.size = size;
+                }
+            }
+            results.push_back(std::move(result));
+        }
+    }
+
+    /**
+     * @brief queues the watched files that changed since they were
+     * loaded. The files are checked without the mutex held.
+     * 
+     */
+    void poll(std::unique_lock<std::mutex>& lock) {
+        polled = watches;
+        lock.unlock();
+        for (Watch& watch : polled) {
+            long long modified = -1;
+            long long size = 0;
+            if (watch.modified < 0 || !readStamp(watch.path, modified, size)
+                || (modified == watch.modified && size == watch.size)) {
+                watch.id = -1;
+            } else {
+                watch.modified = modified;
+                watch.size = size;
+            }
+        }
+        lock.lock();
+        for (const Watch& changed : polled) {
+            if (changed.id < 0) {
+                continue;
+            }
+            for (Watch& watch : watches) {
+                if (watch.id == changed.id) {
+                    watch.modified = changed.modified;
+                    watch.size = changed.size;
+                    jobs.push_back({changed.id, ++ serial, changed.path, changed.type});
+                }
+            }
+        }
+    }
+};
+
+class RCEngine {
+protected:
+    // graphics info
+    int cellRows;   // number of rows of cells
+    int cellCols;   // number of columns of cells
+    int cellWidth;  // the width of the cell
+    int cellHeight; // the height of the cell
+    int screenWidth;    // the width of the screen
+    int screenHeight;   // the height of the screen
+    std::string windowTitle; // the title of the window
+    RenderBackend renderBackend; // how the cells are submitted to the renderer
+    bool retainedMode;  // only redraw the cells that changed since the last frame
+    DisplayMode displayMode;    // where the console is displayed
+
+    // timing
+    double fixedDeltaTime;  // when positive, every frame advances exactly this many seconds
+    long frameLimit;    // when positive, the game loop stops after this many frames
+    double updateRate;  // when positive, update runs this many times per second with a fixed step
+    int maxUpdatesPerFrame;     // fixed steps run by a frame at most, the rest of the backlog is dropped
+    double maxFrameRate;    // when positive, the game loop sleeps to stay under this many frames per second
+    bool vsync;     // synchronize presentation with the display refresh
+    bool pipelined;     // run render on a worker thread, one frame ahead of presentation
+    int workerThreads;  // threads used by parallel drawing including the caller, 0 for one per hardware thread
+    int bandRows;   // rows of cells in a band rasterized by one thread of the software backend
+
+    // text
+    std::string fontPath;   // TTF font for the code points past the tileset, none if empty
+    int fontSize;   // point size of the font, 0 for the cell height
+    int glyphPages;     // atlas pages of 1024x1024 the glyph cache may create
+    size_t maxTextBlocks;   // laid-out blocks kept by writeCachedText, those unused this frame are dropped past it
+
+    // assets
+    double assetReloadInterval;     // when positive, the files of the assets are checked for changes this often in seconds and reloaded
+
+    // profiling
+    FrameProfiler profiler;     // set profiler.enabled to time the phases of every frame
+    bool profilerOverlay;   // draw the profiler statistics over the top-left corner, implies profiling
+
+    // frame capture
+    int captureInterval;    // when positive, every captureInterval-th frame is written to disk
+    std::string capturePath;    // prefix of the captured files, the frame number and extension are appended
+    CaptureFormat captureFormat;    // the format of the periodic captures
+
+    // input recording
+    std::string recordPath;     // when set, the events and delta time of every frame are recorded to this file
+    std::string replayPath;     // when set, the frames of this recording replace the SDL events and the clock, and run without sleeping
+
+    // inputs
+    struct KeyState {
+        bool pressed;
+        bool released;
+        bool hold;
+    };
+    static constexpr int TOTAL_KEYS = SDL_NUM_SCANCODES;
+    static constexpr int TOTAL_CURSOR_STATES = 5;
+    std::bitset<TOTAL_KEYS> keyHold;    // indexed by scancode
+    std::bitset<TOTAL_KEYS> keyPressed;
+    std::bitset<TOTAL_KEYS> keyReleased;
+    std::bitset<TOTAL_CURSOR_STATES> cursorHold;
+    std::bitset<TOTAL_CURSOR_STATES> cursorPressed;
+    std::bitset<TOTAL_CURSOR_STATES> cursorReleased;
+    int cursorPosX;
+    int cursorPosY;
+
+private:
+    SDL_Window* window;
+    SDL_Renderer* renderer;
+    SDL_Surface* frameSurface;  // the target of the offscreen renderer
+    SDL_Texture* tileset;
+    int numSrcRows;     // number of rows in the tileset
+    int numSrcCols;     // number of columns in the tileset
+    int tileWidth;      // the width of the character in the tileset
+    int tileHeight;     // the height of the character in the tileset
+    CellBuffer buffer;
+    CellBuffer frontBuffer;     // the cells being presented while pipelined
+
+    // layers
+    std::vector<std::unique_ptr<CellLayer>> layers;     // indexed by layer id, removed layers are null
+    std::vector<CellLayer*> layerOrder;     // the layers sorted by z
+    std::vector<bool> layerBelow;   // whether each layer was in baseCells when it was last composited
+    CellBuffer baseCells;   // the layers under the console composited over the cleared cells
+    bool baseValid;
+    CellBuffer* drawTarget;     // where the drawing functions draw
+    int drawTargetLayer;
+    std::vector<SDL_Color> layerForeRow;    // a row of a translucent layer scaled by its opacity
+    std::vector<SDL_Color> layerBackRow;
+
+    // scratch of the polygon rasterizer
+    std::vector<SDL_FPoint> polygonPoints;
+    std::vector<double> polygonCrossings;
+    std::vector<std::pair<int, int>> polygonSpans;
+
+    // text laid out by writeCachedText, by the hash of its parameters
+    struct TextBlock {
+        std::string text;
+        int width;
+        TextAlign align;
+        bool wrap;
+        SDL_Color foreColor;
+        SDL_Color backColor;
+        CellImage image;
+        long lastUsed;  // the last frame that drew the block
+    };
+    std::unordered_map<Uint64, TextBlock> textBlocks;
+
+    // the colors of writeText, changed by its markup
+    struct TextStyle {
+        SDL_Color foreColor;
+        SDL_Color backColor;
+        SDL_Color baseForeColor;    // the colors {/} restores
+        SDL_Color baseBackColor;
+    };
+
+    std::unique_ptr<ThreadPool> threadPool;     // created on first use, or before the render thread starts
+
+    // memory for the game, see getFrameArena and getPool
+    FrameArena frameArena;
+    std::pmr::synchronized_pool_resource pool;
+    Uint64 frameHeapAllocations;    // rceHeapAllocations at the start of the frame
+
+    // assets, the tileset is one of them
+    AssetManager assets;
+    int tilesetAsset;   // the asset of the tileset in use, -1 without one
+    int pendingTileset;     // the asset of the tileset set by setTileset until it is loaded, -1 for none
+    int tilesetVersion;     // the version of tilesetAsset that tileset was made from
+
+    // pipelined rendering, render runs on renderThread while the main
+    // thread presents the previous frame
+    std::thread renderThread;
+    std::mutex renderMutex;
+    std::condition_variable renderWake;     // signals the render thread
+    std::condition_variable renderIdle;     // signals the main thread
+    bool renderRequested;   // a frame is waiting to be rendered or being rendered
+    bool renderThreadRunning;
+    bool renderResult;  // what render returned for the last frame
+    double renderDeltaTime;
+    double renderAlpha;
+
+    // batched geometry, the background quads of all cells followed by
+    // the glyph quads of all cells
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+    std::vector<SDL_FPoint> glyphTexCoords;     // top-left uv of each glyph
+    SDL_FPoint tileTexSize;     // the size of a glyph in uv space
+    TTF_Font* font;
+    std::unique_ptr<GlyphCache> glyphCache;     // glyphs of font, created with the font
+    std::vector<int> glyphPage;     // for each cell, the atlas page of its glyph, -1 for the tileset
+    int atlasGlyphs;    // cells of the frame with a glyph from the atlas
+    std::vector<int> tilesetIndices;    // the index stream split by texture when atlas glyphs are used
+    std::vector<std::vector<int>> pageIndices;
+
+    // retained mode
+    SDL_Texture* frameTexture;  // the composed frame kept between frames, streamed from framePixels by the software backend
+    bool frameValid;    // whether frameTexture matches prevBuffer
+    CellBuffer prevBuffer;  // the cells composed into frameTexture
+    std::vector<int> dirtyIndices;  // index stream of the dirty cells
+    std::vector<SDL_Rect> dirtyRects;   // coalesced dirty rectangles in pixels
+    std::vector<int> openRects;     // dirty rects that may grow into the next row
+    std::vector<int> nextOpenRects;
+    int dirtyCells;     // number of cells redrawn by the last renderBuffer
+
+    // terminal display
+    std::string terminalOutput;     // the escape sequences of a frame, written at once
+    inline static std::atomic<bool> terminalScreen{false};  // whether the alternate screen is shown
+    int terminalX;  // the terminal cursor, -1 when unknown
+    int terminalY;
+    Uint32 terminalFore;    // the colors set in the terminal as 0xRRGGBB, NO_COLOR when unknown
+    Uint32 terminalBack;
+
+    // software backend
+    std::vector<Uint8> tileMasks;   // the coverage of each tileset glyph scaled to a cell, row by row
+    bool binaryTileMasks;   // every coverage of tileMasks is 0 or 255
+    std::vector<Uint32> framePixels;    // the rasterized frame, unused offscreen where frameSurface is drawn into
+    std::vector<const GlyphCache::Glyph*> cellGlyphs;   // the font glyph of each cell past the tileset
+    std::vector<int> bandDirtyCells;    // cells rasterized in each band by the last frame
+    std::vector<int> bandFontCells;     // cells of each band past the tileset, whose glyphs come from the font
+
+    // frame capture
+    FrameWriter frameWriter;
+    bool captureRequested;  // read the pixels of the frame being presented
+    std::string requestedCapturePath;   // where to write the requested capture, if anywhere
+    CaptureFormat requestedCaptureFormat;
+    bool nextCaptureRequested;  // set by captureFrame, handed to present with the frame it was made during
+    std::string nextCapturePath;
+    CaptureFormat nextCaptureFormat;
+    long presentedFrame;    // the frame number of the cells being presented
+    FrameCapture lastCapture;   // the pixels of the last requested capture
+
+    // events info
+    SDL_Event event;
+
+    // inputs
+    std::vector<InputEvent> inputEvents;    // inputs not yet seen by an update
+    size_t appliedEvents;   // the number of inputEvents already applied to the key and cursor states
+    InputLog inputLog;
+    std::vector<SDL_Event> replayEvents;    // the recorded events of the frame being replayed
+
+    // game info
+    bool loop;
+    long frameCount;    // number of frames since the game loop started
+    std::chrono::steady_clock::duration sleepOvershoot;     // how late sleep_for usually returns
+    char titleText[256];    // the window title with the frame rate
+    double titleTime;   // seconds since the title was updated
+    int titleFrames;    // frames since the title was updated
+    static constexpr int OVERLAY_LINES = FrameProfiler::NUM_PHASES + FrameProfiler::NUM_COUNTERS + 1;
+    char overlayText[OVERLAY_LINES][40];   // the lines of the profiler overlay
+
+public:
+    RCEngine() {
+        cellRows = 0;
+        cellCols = 0;
+        screenWidth = 0;
+        screenHeight = 0;
+        windowTitle = "RCEngine";
+        renderBackend = RenderBackend::Geometry;
+        displayMode = DisplayMode::Window;
+        fixedDeltaTime = 0.0;
+        frameLimit = 0;
+        updateRate = 0.0;
+        maxUpdatesPerFrame = 8;
+        maxFrameRate = 0.0;
+        vsync = false;
+        pipelined = false;
+        workerThreads = 0;
+        bandRows = 4;
+        fontSize = 0;
+        glyphPages = 4;
+        maxTextBlocks = 256;
+        assetReloadInterval = 0.0;
+        tilesetAsset = -1;
+        pendingTileset = -1;
+        tilesetVersion = 0;
+        profilerOverlay = false;
+        titleText[0] = '\0';
+        titleTime = 0.0;
+        titleFrames = 0;
+        for (int i = 0; i < OVERLAY_LINES; i ++) {
+            overlayText[i][0] = '\0';
+        }
+        renderRequested = false;
+        renderThreadRunning = false;
+        renderResult = true;
+        renderDeltaTime = 0.0;
+        renderAlpha = 1.0;
+        frameCount = 0;
+        sleepOvershoot = std::chrono::milliseconds(1);
+        captureInterval = 0;
+        capturePath = "frame";
+        captureFormat = CaptureFormat::PNG;
+        captureRequested = false;
+        requestedCaptureFormat = CaptureFormat::PNG;
+        nextCaptureRequested = false;
+        nextCaptureFormat = CaptureFormat::PNG;
+        presentedFrame = 0;
+        lastCapture = {-1, 0, 0, {}};
+        retainedMode = false;
+        frameTexture = nullptr;
+        frameValid = false;
+        dirtyCells = 0;
+        binaryTileMasks = true;
+        terminalX = -1;
+        terminalY = -1;
+        terminalFore = NO_COLOR;
+        terminalBack = NO_COLOR;
+        baseValid = false;
+        drawTarget = &buffer;
+        drawTargetLayer = CONSOLE_LAYER;
+        frameHeapAllocations = 0;
+
+        cursorPosX = 0;
+        cursorPosY = 0;
+        appliedEvents = 0;
+    }
+
+    ~RCEngine() {}
+
+    /**
+     * @brief Creates the console window
+     * 
+     * @param tilesetPath the path to the tileset
+     * @param rows number of rows of cells
+     * @param cols number of columns of cells
+     * @param fontWidth the width of the cell
+     * @param fontHeight the height of the cell
+     * @return true
+     * @return false
+     */
+    bool createConsole(std::string tilesetPath = "./RCE_tileset.png", int rows = 30, int cols = 40, int fontWidth = 20, int fontHeight = 20) {
+        cellRows = rows;
+        cellCols = cols;
+        cellWidth = fontWidth;
+        cellHeight = fontHeight;
+        numSrcRows = 16;
+        numSrcCols = 16;
+        screenWidth = cellCols * cellWidth;
+        screenHeight = cellRows * cellHeight;
+
+        window = nullptr;
+        renderer = nullptr;
+        frameSurface = nullptr;
+        tileset = nullptr;
+        font = nullptr;
+
+        loop = false;
+
+        tileWidth = 0;
+        tileHeight = 0;
+
+        Uint32 subsystems = SDL_INIT_EVENTS;
+        if (displayMode == DisplayMode::Window) {
+            subsystems |= SDL_INIT_VIDEO | SDL_INIT_AUDIO;
+        }
+        if (SDL_Init(subsystems) < 0) {
+            std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
+            return false;
+        } else if (displayMode == DisplayMode::Window) {
+            window = SDL_CreateWindow(windowTitle.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screenWidth, screenHeight, SDL_WINDOW_SHOWN);
+            SDL_SetWindowFullscreen(window, 0);
+            SDL_RaiseWindow(window);
+            if (!window) {
+                std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
+                return false;
+            } else {
+                renderer = SDL_CreateRenderer(window, -1, vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
+                if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
+                    std::cerr << "Failed to load SDL_mixer: " << Mix_GetError() << std::endl;
+                    return false;
+                }
+            }
+        } else if (displayMode == DisplayMode::Offscreen) {
+            frameSurface = SDL_CreateRGBSurfaceWithFormat(0, screenWidth, screenHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+            if (!frameSurface) {
+                std::cerr << "Failed to create offscreen surface: " << SDL_GetError() << std::endl;
+                return false;
+            } else {
+                renderer = SDL_CreateSoftwareRenderer(frameSurface);
+            }
+        }
+
+        buffer.resize(cellRows, cellCols);
+        frontBuffer.resize(cellRows, cellCols);
+        baseCells.resize(cellRows, cellCols);
+        baseValid = false;
+        prevBuffer.resize(cellRows, cellCols);
+        assets.setRenderer(renderer);
+        assets.setReloadInterval(assetReloadInterval);
+        if (displayMode == DisplayMode::Terminal) {
+            enterTerminal();
+            frameValid = false;
+        }
+        if (displayMode == DisplayMode::Null || displayMode == DisplayMode::Terminal) {
+            return true;
+        }
+
+        if (!renderer) {
+            std::cerr << "Failed to create renderer: " << SDL_GetError() << std::endl;
+            return false;
+        }
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+            std::cerr << "Failed to load SDL_image: " << IMG_GetError() << std::endl;
+            return false;
+        }
+
+        // every glyph of the first frame comes from the tileset, so it
+        // is the one asset loaded before the game starts
+        tilesetAsset = assets.load(tilesetPath, AssetType::Texture);
+        if (!assets.getTexture(tilesetAsset)) {
+            std::cerr << "Error creating texture from " << tilesetPath << std::endl;
+            return false;
+        }
+        if (!applyTileset() && renderBackend == RenderBackend::Software) {
+            std::cerr << "Failed to decode the tileset, falling back to the geometry backend: " << SDL_GetError() << std::endl;
+            renderBackend = RenderBackend::Geometry;
+        }
+
+        if (renderer && !fontPath.empty()) {
+            if (TTF_Init() < 0) {
+                std::cerr << "Failed to initialize SDL_ttf: " << TTF_GetError() << std::endl;
+                return false;
+            }
+            font = TTF_OpenFont(fontPath.c_str(), fontSize > 0 ? fontSize : cellHeight);
+            if (!font) {
+                std::cerr << "Failed to load font " << fontPath << ": " << TTF_GetError() << std::endl;
+                return false;
+            }
+            SDL_Renderer* pageRenderer = renderBackend == RenderBackend::Software ? nullptr : renderer;
+            glyphCache.reset(new GlyphCache(pageRenderer, font, cellWidth, cellHeight, 1024, glyphPages));
+        }
+
+        initGeometry();
+        return true;
+    }
+
+    /**
+     * @brief blends two colors, color2 over color1, computed in fixed
+     * point. Over an opaque color1 the result is opaque and equals the
+     * rounded exact value (color2 * a2 + color1 * (1 - a2)) with alphas
+     * in [0, 1]. Over a translucent color1, as in the cells of a layer,
+     * the result has alpha a2 + a1 * (1 - a2) and the colors weighted by
+     * a2 and a1 * (1 - a2).
+     * 
+     * @param color1 (r, g, b, a)
+     * @param color2 (r, g, b, a)
+     * @return SDL_Color 
+     */
+    static inline SDL_Color blendColor(SDL_Color color1, SDL_Color color2) {
+        int alpha = color2.a;
+        int inverse = 255 - alpha;
+        if (color1.a == 255) {
+            return {div255(color2.r * alpha + color1.r * inverse),
+                    div255(color2.g * alpha + color1.g * inverse),
+                    div255(color2.b * alpha + color1.b * inverse), 255};
+        }
+        // weights are scaled by 255 * 255
+        int weight1 = color1.a * inverse;
+        int weight2 = alpha * 255;
+        int total = weight1 + weight2;
+        if (total == 0) {
+            return color1;
+        }
+        return {static_cast<Uint8>((color2.r * weight2 + color1.r * weight1 + total / 2) / total),
+                static_cast<Uint8>((color2.g * weight2 + color1.g * weight1 + total / 2) / total),
+                static_cast<Uint8>((color2.b * weight2 + color1.b * weight1 + total / 2) / total),
+                static_cast<Uint8>((total + 127) / 255)};
+    }
+
+    /**
+     * @brief blends color over every color of a span,
+     * same as dest[i] = blendColor(dest[i], color)
+     * 
+     * @param dest the colors to blend onto
+     * @param color (r, g, b, a)
+     * @param count number of colors in dest
+     */
+    static void blendColorSpan(SDL_Color* dest, SDL_Color color, int count) {
+        int i = 0;
+        if (color.a == 255) {
+            std::fill(dest, dest + count, color);
+            return;
+        }
+#if defined(RCE_AVX2)
+        const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m256i srcTerm = _mm256_setr_epi16(color.r * color.a, color.g * color.a, color.b * color.a, 0,
+            color.r * color.a, color.g * color.a, color.b * color.a, 0,
+            color.r * color.a, color.g * color.a, color.b * color.a, 0,
+            color.r * color.a, color.g * color.a, color.b * color.a, 0);
+        const __m256i inverse = _mm256_set1_epi16(255 - color.a);
+        for (; i + 8 <= count; i += 8) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(pixels, opaque), opaque)) != -1) {
+                for (int k = i; k < i + 8; k ++) {
+                    dest[k] = blendColor(dest[k], color);
+                }
+                continue;
+            }
+            __m256i low = blendLanes(_mm256_unpacklo_epi8(pixels, _mm256_setzero_si256()), srcTerm, inverse);
+            __m256i high = blendLanes(_mm256_unpackhi_epi8(pixels, _mm256_setzero_si256()), srcTerm, inverse);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_or_si256(_mm256_packus_epi16(low, high), opaque));
+        }
+#elif defined(RCE_SSE2)
+        const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m128i srcTerm = _mm_setr_epi16(color.r * color.a, color.g * color.a, color.b * color.a, 0,
+            color.r * color.a, color.g * color.a, color.b * color.a, 0);
+        const __m128i inverse = _mm_set1_epi16(255 - color.a);
+        for (; i + 4 <= count; i += 4) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(pixels, opaque), opaque)) != 0xFFFF) {
+                for (int k = i; k < i + 4; k ++) {
+                    dest[k] = blendColor(dest[k], color);
+                }
+                continue;
+            }
+            __m128i low = blendLanes(_mm_unpacklo_epi8(pixels, _mm_setzero_si128()), srcTerm, inverse);
+            __m128i high = blendLanes(_mm_unpackhi_epi8(pixels, _mm_setzero_si128()), srcTerm, inverse);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+        }
+#endif
+        for (; i < count; i ++) {
+            dest[i] = blendColor(dest[i], color);
+        }
+    }
+
+    /**
+     * @brief blends a span of colors over another,
+     * same as dest[i] = blendColor(dest[i], colors[i])
+     * 
+     * @param dest the colors to blend onto
+     * @param colors the colors to blend
+     * @param count number of colors in dest and colors
+     */
+    static void blendColorSpan(SDL_Color* dest, const SDL_Color* colors, int count) {
+        int i = 0;
+#if defined(RCE_AVX2)
+        const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m256i full = _mm256_set1_epi16(255);
+        for (; i + 8 <= count; i += 8) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dest + i));
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(pixels, opaque), opaque)) != -1) {
+                for (int k = i; k < i + 8; k ++) {
+                    dest[k] = blendColor(dest[k], colors[k]);
+                }
+                continue;
+            }
+            __m256i source = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colors + i));
+            __m256i sourceLow = _mm256_unpacklo_epi8(source, _mm256_setzero_si256());
+            __m256i sourceHigh = _mm256_unpackhi_epi8(source, _mm256_setzero_si256());
+            __m256i alphaLow = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sourceLow, 0xFF), 0xFF);
+            __m256i alphaHigh = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sourceHigh, 0xFF), 0xFF);
+            __m256i low = blendLanes(_mm256_unpacklo_epi8(pixels, _mm256_setzero_si256()),
+                _mm256_mullo_epi16(sourceLow, alphaLow), _mm256_sub_epi16(full, alphaLow));
+            __m256i high = blendLanes(_mm256_unpackhi_epi8(pixels, _mm256_setzero_si256()),
+                _mm256_mullo_epi16(sourceHigh, alphaHigh), _mm256_sub_epi16(full, alphaHigh));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), _mm256_or_si256(_mm256_packus_epi16(low, high), opaque));
+        }
+#elif defined(RCE_SSE2)
+        const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+        const __m128i full = _mm_set1_epi16(255);
+        for (; i + 4 <= count; i += 4) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(pixels, opaque), opaque)) != 0xFFFF) {
+                for (int k = i; k < i + 4; k ++) {
+                    dest[k] = blendColor(dest[k], colors[k]);
+                }
+                continue;
+            }
+            __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+            __m128i sourceLow = _mm_unpacklo_epi8(source, _mm_setzero_si128());
+            __m128i sourceHigh = _mm_unpackhi_epi8(source, _mm_setzero_si128());
+            __m128i alphaLow = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sourceLow, 0xFF), 0xFF);
+            __m128i alphaHigh = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sourceHigh, 0xFF), 0xFF);
+            __m128i low = blendLanes(_mm_unpacklo_epi8(pixels, _mm_setzero_si128()),
+                _mm_mullo_epi16(sourceLow, alphaLow), _mm_sub_epi16(full, alphaLow));
+            __m128i high = blendLanes(_mm_unpackhi_epi8(pixels, _mm_setzero_si128()),
+                _mm_mullo_epi16(sourceHigh, alphaHigh), _mm_sub_epi16(full, alphaHigh));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_packus_epi16(low, high), opaque));
+        }
+#endif
+        for (; i < count; i ++) {
+            dest[i] = blendColor(dest[i], colors[i]);
+        }
+    }
+
+    /**
+     * @brief blends color over a rectangle of a color plane
+     * 
+     * @param plane the color plane
+     * @param pitch number of colors in a row of the plane
+     * @param rect (x, y, w, h), must lie inside the plane
+     * @param color (r, g, b, a)
+     */
+    static void blendColorRect(SDL_Color* plane, int pitch, SDL_Rect rect, SDL_Color color) {
+        for (int i = rect.y; i < rect.y + rect.h; i ++) {
+            blendColorSpan(plane + i * pitch + rect.x, color, rect.w);
+        }
+    }
+
+    /**
+     * @brief draws a charactor ch at (x, y) width foreColor and backColor
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @param ch charactor
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     */
+    void draw(int x, int y, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        CellBuffer& cells = *drawTarget;
+        if (0 <= x && x < cells.getCols() && 0 <= y && y < cells.getRows()) {
+            int index = cells.index(x, y);
+            cells.chs()[index] = ch;
+            cells.foreColors()[index] = blendColor(cells.foreColors()[index], foreColor);
+            cells.backColors()[index] = blendColor(cells.backColors()[index], backColor);
+        }
+    }
+
+    /**
+     * @brief draws a line from (x1, y1) to (x2, y2), clipped to the
+     * draw target
+     * 
+     * @param x1 
+     * @param y1 
+     * @param x2 
+     * @param y2 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawLine(int x1, int y1, int x2, int y2, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        rasterizeLine(x1, y1, x2, y2, ch, foreColor, backColor, true);
+    }
+
+    /**
+     * @brief draws a line thickness cells wide from (x1, y1) to (x2, y2)
+     * 
+     * @param x1 
+     * @param y1 
+     * @param x2 
+     * @param y2 
+     * @param thickness width of the line in cells, 1 draws like drawLine
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawThickLine(int x1, int y1, int x2, int y2, int thickness, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        double length = std::hypot(x2 - x1, y2 - y1);
+        if (thickness <= 1 || length == 0.0) {
+            if (thickness > 1) {
+                fill({x1 - thickness / 2, y1 - thickness / 2, thickness, thickness}, ch, foreColor, backColor);
+            } else {
+                drawLine(x1, y1, x2, y2, ch, foreColor, backColor);
+            }
+            return;
+        }
+        // a quad around the segment reaching half a cell past its end cells,
+        // shifted by half a cell when even so that axis-aligned edges fall
+        // between cells
+        double ux = (x2 - x1) / length;
+        double uy = (y2 - y1) / length;
+        double shift = thickness % 2 == 0 ? 0.5 : 0.0;
+        double outer = shift + thickness / 2.0;
+        double inner = shift - thickness / 2.0;
+        double ax = x1 - ux * 0.5;
+        double ay = y1 - uy * 0.5;
+        double bx = x2 + ux * 0.5;
+        double by = y2 + uy * 0.5;
+        const SDL_FPoint quad[4] = {
+            {static_cast<float>(ax - uy * outer), static_cast<float>(ay + ux * outer)},
+            {static_cast<float>(bx - uy * outer), static_cast<float>(by + ux * outer)},
+            {static_cast<float>(bx - uy * inner), static_cast<float>(by + ux * inner)},
+            {static_cast<float>(ax - uy * inner), static_cast<float>(ay + ux * inner)}
+        };
+        rasterizePolygon(quad, 4, ch, foreColor, backColor);
+    }
+
+    /**
+     * @brief draws the outline of a rectangle
+     * 
+     * @param dest (x, y, w, h)
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawRect(SDL_Rect dest, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        if (dest.w <= 0 || dest.h <= 0) {
+            return;
+        }
+        fill({dest.x, dest.y, dest.w, 1}, ch, foreColor, backColor);
+        if (dest.h > 1) {
+            fill({dest.x, dest.y + dest.h - 1, dest.w, 1}, ch, foreColor, backColor);
+        }
+        fill({dest.x, dest.y + 1, 1, dest.h - 2}, ch, foreColor, backColor);
+        if (dest.w > 1) {
+            fill({dest.x + dest.w - 1, dest.y + 1, 1, dest.h - 2}, ch, foreColor, backColor);
+        }
+    }
+
+    /**
+     * @brief draws a frame of box-drawing characters of the tileset
+     * around a rectangle, the rectangle included
+     * 
+     * @param dest (x, y, w, h)
+     * @param style single or double lines
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawFrame(SDL_Rect dest, FrameStyle style = FrameStyle::Single, SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        // corners clockwise from the top-left, then the horizontal and vertical edges, in CP437
+        static const Uint32 glyphs[2][6] = {{218, 191, 217, 192, 196, 179}, {201, 187, 188, 200, 205, 186}};
+        const Uint32* glyph = glyphs[style == FrameStyle::Double];
+        if (dest.w < 2 || dest.h < 2) {
+            drawRect(dest, dest.w == 1 ? glyph[5] : glyph[4], foreColor, backColor);
+            return;
+        }
+        int right = dest.x + dest.w - 1;
+        int bottom = dest.y + dest.h - 1;
+        fill({dest.x + 1, dest.y, dest.w - 2, 1}, glyph[4], foreColor, backColor);
+        fill({dest.x + 1, bottom, dest.w - 2, 1}, glyph[4], foreColor, backColor);
+        fill({dest.x, dest.y + 1, 1, dest.h - 2}, glyph[5], foreColor, backColor);
+        fill({right, dest.y + 1, 1, dest.h - 2}, glyph[5], foreColor, backColor);
+        draw(dest.x, dest.y, glyph[0], foreColor, backColor);
+        draw(right, dest.y, glyph[1], foreColor, backColor);
+        draw(right, bottom, glyph[2], foreColor, backColor);
+        draw(dest.x, bottom, glyph[3], foreColor, backColor);
+    }
+
+    /**
+     * @brief fills a circle, the cells whose centers are within radius
+     * and a half of (x, y)
+     * 
+     * @param x x-coordinate of the center
+     * @param y y-coordinate of the center
+     * @param radius 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void fillCircle(int x, int y, int radius, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        if (radius < 0) {
+            return;
+        }
+        CellBuffer& cells = *drawTarget;
+        Sint64 firstRow, lastRow;
+        circleRows(cells, y, radius, firstRow, lastRow);
+        for (Sint64 dy = firstRow; dy <= lastRow; dy ++) {
+            Sint64 half = circleHalfWidth(radius, static_cast<int>(dy));
+            drawSpan(cells, x - half, x + half, y + dy, ch, foreColor, backColor);
+        }
+    }
+
+    /**
+     * @brief draws the outline of a circle, the cells of fillCircle
+     * that are not in the circle of radius - 1, each drawn once
+     * 
+     * @param x x-coordinate of the center
+     * @param y y-coordinate of the center
+     * @param radius 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawCircle(int x, int y, int radius, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        if (radius < 0) {
+            return;
+        }
+        CellBuffer& cells = *drawTarget;
+        Sint64 firstRow, lastRow;
+        circleRows(cells, y, radius, firstRow, lastRow);
+        for (Sint64 dy = firstRow; dy <= lastRow; dy ++) {
+            Sint64 outer = circleHalfWidth(radius, static_cast<int>(dy));
+            Sint64 inner = (dy < 0 ? -dy : dy) < radius ? circleHalfWidth(radius - 1, static_cast<int>(dy)) : -1;
+            if (inner < 0) {
+                drawSpan(cells, x - outer, x + outer, y + dy, ch, foreColor, backColor);
+            } else {
+                drawSpan(cells, x - outer, x - inner - 1, y + dy, ch, foreColor, backColor);
+                drawSpan(cells, x + inner + 1, x + outer, y + dy, ch, foreColor, backColor);
+            }
+        }
+    }
+
+    /**
+     * @brief fills a triangle, the cells whose centers are inside it
+     * 
+     * @param x1 
+     * @param y1 
+     * @param x2 
+     * @param y2 
+     * @param x3 
+     * @param y3 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void fillTriangle(int x1, int y1, int x2, int y2, int x3, int y3, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        const SDL_FPoint points[3] = {
+            {static_cast<float>(x1), static_cast<float>(y1)},
+            {static_cast<float>(x2), static_cast<float>(y2)},
+            {static_cast<float>(x3), static_cast<float>(y3)}
+        };
+        rasterizePolygon(points, 3, ch, foreColor, backColor);
+    }
+
+    /**
+     * @brief draws the outline of a triangle
+     * 
+     * @param x1 
+     * @param y1 
+     * @param x2 
+     * @param y2 
+     * @param x3 
+     * @param y3 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawTriangle(int x1, int y1, int x2, int y2, int x3, int y3, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        const SDL_Point points[3] = {{x1, y1}, {x2, y2}, {x3, y3}};
+        drawPolygon(points, 3, ch, foreColor, backColor);
+    }
+
+    /**
+     * @brief fills a polygon with the even-odd rule, the cells whose
+     * centers are inside it
+     * 
+     * @param points the vertices in order
+     * @param count number of vertices
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void fillPolygon(const SDL_Point* points, int count, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        polygonPoints.resize(std::max(count, 0));
+        for (int i = 0; i < count; i ++) {
+            polygonPoints[i] = {static_cast<float>(points[i].x), static_cast<float>(points[i].y)};
+        }
+        rasterizePolygon(polygonPoints.data(), static_cast<int>(polygonPoints.size()), ch, foreColor, backColor);
+    }
+
+    /**
+     * @brief fills a polygon with the even-odd rule, the cells whose
+     * centers are inside it
+     * 
+     * @param points the vertices in order
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void fillPolygon(const std::vector<SDL_Point>& points, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        fillPolygon(points.data(), static_cast<int>(points.size()), ch, foreColor, backColor);
+    }
+
+    /**
+     * @brief draws the closed outline of a polygon, drawing each vertex
+     * once
+     * 
+     * @param points the vertices in order
+     * @param count number of vertices
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawPolygon(const SDL_Point* points, int count, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        if (count == 1) {
+            draw(points[0].x, points[0].y, ch, foreColor, backColor);
+            return;
+        }
+        if (count == 2) {
+            // both edges would cover the same cells, blending them twice
+            rasterizeLine(points[0].x, points[0].y, points[1].x, points[1].y, ch, foreColor, backColor, true);
+            return;
+        }
+        for (int i = 0; i < count; i ++) {
+            const SDL_Point& from = points[i];
+            const SDL_Point& to = points[(i + 1) % count];
+            rasterizeLine(from.x, from.y, to.x, to.y, ch, foreColor, backColor, false);
+        }
+    }
+
+    /**
+     * @brief draws the closed outline of a polygon, drawing each vertex
+     * once
+     * 
+     * @param points the vertices in order
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void drawPolygon(const std::vector<SDL_Point>& points, Uint32 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
+        drawPolygon(points.data(), static_cast<int>(points.size()), ch, foreColor, backColor);
+    }
+
+    /**
+     * @brief Get the character at (x, y)
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @return Uint32 the code point
+     */
+    Uint32 getCh(int x, int y) const {
+        const CellBuffer& cells = *drawTarget;
+        if (0 <= x && x < cells.getCols() && 0 <= y && y < cells.getRows()) {
+            return cells.chs()[cells.index(x, y)];
+        } else {
+            return 0;
+        }
+    }
+
+    /**
+     * @brief Get the Fore Color at (x, y)
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @return SDL_Color 
+     */
+    SDL_Color getForeColor(int x, int y) const {
+        const CellBuffer& cells = *drawTarget;
+        if (0 <= x && x < cells.getCols() && 0 <= y && y < cells.getRows()) {
+            return cells.foreColors()[cells.index(x, y)];
+        } else {
+            return {0, 0, 0, 0};
+        }
+    }
+
+    /**
+     * @brief Get the Back Color at (x, y)
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @return SDL_Color 
+     */
+    SDL_Color getBackColor(int x, int y) const {
+        const CellBuffer& cells = *drawTarget;
+        if (0 <= x && x < cells.getCols() && 0 <= y && y < cells.getRows()) {
+            return cells.backColors()[cells.index(x, y)];
+        } else {
+            return {0, 0, 0, 0};
+        }
+    }
+
+    /**
+     * @brief decodes the UTF-8 code point at pos and moves pos past it;
+     * a byte that does not start a valid sequence is returned as itself,
+     * so strings of tileset (CP437) bytes keep working
+     * 
+     * @param text 
+     * @param pos the index of the first byte of the code point
+     * @return Uint32 the code point
+     */
+    static Uint32 decodeUTF8(std::string_view text, size_t& pos) {
+        Uint8 lead = static_cast<Uint8>(text[pos]);
+        int length = lead < 0xC2 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 1;
+        if (length == 1 || pos + length > text.length()) {
+            pos ++;
+            return lead;
+        }
+        Uint32 codePoint = lead & (0x7F >> length);
+        for (int i = 1; i < length; i ++) {
+            Uint8 byte = static_cast<Uint8>(text[pos + i]);
+            if ((byte & 0xC0) != 0x80) {
+                pos ++;
+                return lead;
+            }
+            codePoint = (codePoint << 6) | (byte & 0x3F);
+        }
+        const Uint32 minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+        if (codePoint < minimum[length] || codePoint > 0x10FFFF || (0xD800 <= codePoint && codePoint < 0xE000)) {
+            pos ++;
+            return lead;
+        }
+        pos += length;
+        return codePoint;
+    }
+
+    /**
+     * @brief write a UTF-8 string to the screen starting at (x, y), one
+     * cell per code point, clipped to the draw target. Spaces are not
+     * drawn.
+     * 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @param content 
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     */
+    void write(int x, int y, std::string_view content, SDL_Color foreColor = {0, 0, 0, 0}, SDL_Color backColor = {0, 0, 0, 0}) {
+        CellBuffer& cells = *drawTarget;
+        if (0 <= y && y < cells.getRows()) {
+            size_t len = content.length();
+            Uint32* chs = cells.chs() + cells.index(0, y);
+            SDL_Color* foreColors = cells.foreColors() + cells.index(0, y);
+            SDL_Color* backColors = cells.backColors() + cells.index(0, y);
+            size_t pos = 0;
+            for (int i = x; pos < len && i < cells.getCols(); i ++) {
+                Uint32 ch = decodeUTF8(content, pos);
+                if (ch == ' ' || i < 0) continue;
+                chs[i] = ch;
+                foreColors[i] = blendColor(foreColors[i], foreColor);
+                backColors[i] = blendColor(backColors[i], backColor);
+            }
+        }
+    }
+
+    /**
+     * @brief writes UTF-8 text into a box, clipped to it: lines break at
+     * '\n', and with wrap also at the last space that fits, or inside
+     * words longer than the box. Spaces are not drawn.
+     * 
+     * The text may change its colors with the markup {fg:RRGGBB} and
+     * {bg:RRGGBB} (or RRGGBBAA), {/} restores foreColor and backColor,
+     * and {{ is a literal {. Nothing is allocated.
+     * 
+     * @param box (x, y, w, h) the cells the text may cover
+     * @param text 
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     * @param align the alignment of each line in the box
+     * @param wrap whether lines longer than the box wrap, or are clipped
+     */
+    void writeText(SDL_Rect box, std::string_view text, SDL_Color foreColor = {0, 0, 0, 0}, SDL_Color backColor = {0, 0, 0, 0}, TextAlign align = TextAlign::Left, bool wrap = true) {
+        CellBuffer& cells = *drawTarget;
+        if (box.w <= 0 || box.h <= 0) {
+            return;
+        }
+        int maxLines = std::min(box.h, cells.getRows() - box.y);
+        layoutText(text, box.w, align, wrap, foreColor, backColor, maxLines, [&](int x, int y, Uint32 ch, SDL_Color fore, SDL_Color back) {
+            x += box.x;
+            y += box.y;
+            if (0 <= x && x < cells.getCols() && 0 <= y) {
+                int index = cells.index(x, y);
+                cells.chs()[index] = ch;
+                cells.foreColors()[index] = blendColor(cells.foreColors()[index], fore);
+                cells.backColors()[index] = blendColor(cells.backColors()[index], back);
+            }
+        });
+    }
+
+    /**
+     * @brief writes text like writeText, but lays it out only the first
+     * time: the laid-out block is kept, keyed by the text, the width of
+     * the box and the other parameters, and blitted in later frames. For
+     * text that stays the same over many frames.
+     * 
+     * @param box (x, y, w, h) the cells the text may cover
+     * @param text 
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     * @param align the alignment of each line in the box
+     * @param wrap whether lines longer than the box wrap, or are clipped
+     */
+    void writeCachedText(SDL_Rect box, std::string_view text, SDL_Color foreColor = {0, 0, 0, 0}, SDL_Color backColor = {0, 0, 0, 0}, TextAlign align = TextAlign::Left, bool wrap = true) {
+        if (box.w <= 0 || box.h <= 0) {
+            return;
+        }
+        const CellImage& image = findTextBlock(text, box.w, align, wrap, foreColor, backColor);
+        blit(image, box.x, box.y, {0, 0, box.w, box.h});
+    }
+
+    /**
+     * @brief measures text laid out like writeText does
+     * 
+     * @param text 
+     * @param width the width of the box
+     * @param wrap whether lines longer than width wrap
+     * @return SDL_Point (the width of the longest line, the number of lines)
+     */
+    SDL_Point measureText(std::string_view text, int width, bool wrap = true) const {
+        return layoutText(text, width, TextAlign::Left, wrap, {0, 0, 0, 0}, {0, 0, 0, 0}, INT_MAX, [](int, int, Uint32, SDL_Color, SDL_Color) {});
+    }
+
+    /**
+     * @brief fills a rectangle region, clipped to the draw target
+     * 
+     * @param dest (x, y, w, h)
+     * @param ch character
+     * @param foreColor (r, g, b, a)
+     * @param backColor (r, g, b, a)
+     */
+    void fill(SDL_Rect dest, Uint32 ch = ' ', SDL_Color foreColor = {0, 0, 0, 0}, SDL_Color backColor = {0, 0, 0, 0}) {
+        CellBuffer& cells = *drawTarget;
+        int left = std::max(dest.x, 0);
+        int right = std::min(dest.x + dest.w, cells.getCols());
+        int top = std::max(dest.y, 0);
+        int bottom = std::min(dest.y + dest.h, cells.getRows());
+        for (int i = top; i < bottom; i ++) {
+            drawSpan(cells, left, right - 1, i, ch, foreColor, backColor);
+        }
+    }
+
+    /**
+     * @brief draws the cells of an image in its mask with the top-left
+     * corner at (x, y), like draw does for each of them
+     * 
+     * @param image 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     */
+    void blit(const CellImage& image, int x, int y) {
+        blit(image, x, y, {0, 0, image.getCols(), image.getRows()});
+    }
+
+    /**
+     * @brief draws the cells of a rectangle of an image, such as a
+     * sprite of a sprite sheet, with its top-left corner at (x, y).
+     * The rectangle is clipped once, then each run of cells in the mask
+     * is copied when it is opaque and blended otherwise.
+     * 
+     * @param image 
+     * @param x x-coordinate (the index of column)
+     * @param y y-coordinate (the index of row)
+     * @param src (x, y, w, h) the cells of the image to draw
+     */
+    void blit(const CellImage& image, int x, int y, SDL_Rect src) {
+        CellBuffer& cells = *drawTarget;
+        // clip against the image, then against the target
+        int left = std::max({src.x, 0, src.x - x});
+        int top = std::max({src.y, 0, src.y - y});
+        int right = std::min({src.x + src.w, image.getCols(), src.x + cells.getCols() - x});
+        int bottom = std::min({src.y + src.h, image.getRows(), src.y + cells.getRows() - y});
+        if (right <= left || bottom <= top) {
+            return;
+        }
+        int shiftX = x - src.x;
+        int shiftY = y - src.y;
+        for (int row = top; row < bottom; row ++) {
+            int count;
+            const CellImage::Run* runs = image.getRuns(row, count);
+            int srcRow = row * image.getCols();
+            int destRow = cells.index(shiftX, row + shiftY);
+            for (int i = 0; i < count; i ++) {
+                int begin = std::max(runs[i].begin, left);
+                int end = std::min(runs[i].end, right);
+                if (begin >= end) {
+                    continue;
+                }
+                int width = end - begin;
+                std::memcpy(cells.chs() + destRow + begin, image.chs() + srcRow + begin, width * sizeof(Uint32));
+                if (runs[i].opaque) {
+                    std::memcpy(cells.foreColors() + destRow + begin, image.foreColors() + srcRow + begin, width * sizeof(SDL_Color));
+                    std::memcpy(cells.backColors() + destRow + begin, image.backColors() + srcRow + begin, width * sizeof(SDL_Color));
+                } else {
+                    blendColorSpan(cells.foreColors() + destRow + begin, image.foreColors() + srcRow + begin, width);
+                    blendColorSpan(cells.backColors() + destRow + begin, image.backColors() + srcRow + begin, width);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief draws the part of a tile map under its camera over the
+     * whole draw target, like draw does for each tile. Tiles that were
+     * in view in the previous call are not fetched from the map again.
+     * 
+     * @param map 
+     */
+    void drawTileMap(TileMap& map) {
+        CellBuffer& cells = *drawTarget;
+        const CellBuffer& view = map.getView(cells.getRows(), cells.getCols());
+        std::memcpy(cells.chs(), view.chs(), cells.size() * sizeof(Uint32));
+        if (map.isViewOpaque()) {
+            std::memcpy(cells.foreColors(), view.foreColors(), cells.size() * sizeof(SDL_Color));
+            std::memcpy(cells.backColors(), view.backColors(), cells.size() * sizeof(SDL_Color));
+        } else {
+            blendColorSpan(cells.foreColors(), view.foreColors(), cells.size());
+            blendColorSpan(cells.backColors(), view.backColors(), cells.size());
+        }
+    }
+
+    /**
+     * @brief draws every live particle into the cell under it in one
+     * pass over the particles. A particle with a character sets it and
+     * colors the foreground, one without only colors the background.
+     * 
+     * @param particles 
+     * @param blend alpha blending in particle order, or additive
+     */
+    void drawParticles(const ParticleSystem& particles, ParticleBlend blend = ParticleBlend::Alpha) {
+        CellBuffer& cells = *drawTarget;
+        const float* posX = particles.getPositionsX();
+        const float* posY = particles.getPositionsY();
+        const float* ages = particles.getAges();
+        const float* lives = particles.getLives();
+        const Uint32* chs = particles.getChs();
+        const SDL_Color* colors = particles.getColors();
+        Uint32* cellChs = cells.chs();
+        SDL_Color* foreColors = cells.foreColors();
+        SDL_Color* backColors = cells.backColors();
+        int pitch = cells.index(0, 1);
+        float cols = static_cast<float>(cells.getCols());
+        float rows = static_cast<float>(cells.getRows());
+        for (int i = 0; i < particles.size(); i ++) {
+            // also rejects NaN
+            if (!(posX[i] >= 0.0f && posX[i] < cols && posY[i] >= 0.0f && posY[i] < rows)) {
+                continue;
+            }
+            int index = static_cast<int>(posY[i]) * pitch + static_cast<int>(posX[i]);
+            SDL_Color color = colors[i];
+            if (particles.fade) {
+                color.a = static_cast<Uint8>(color.a * std::max(0.0f, 1.0f - ages[i] / lives[i]));
+            }
+            SDL_Color& dest = chs[i] ? foreColors[index] : backColors[index];
+            if (chs[i]) {
+                cellChs[index] = chs[i];
+            }
+            if (blend == ParticleBlend::Alpha) {
+                dest = blendColor(dest, color);
+            } else {
+                // saturating sums of positive terms do not depend on the order
+                dest.r = static_cast<Uint8>(std::min(255, dest.r + color.r * color.a / 255));
+                dest.g = static_cast<Uint8>(std::min(255, dest.g + color.g * color.a / 255));
+                dest.b = static_cast<Uint8>(std::min(255, dest.b + color.b * color.a / 255));
+                dest.a = static_cast<Uint8>(std::min(255, dest.a + color.a));
+            }
+        }
+    }
+
+    /**
+     * @brief computes every cell in parallel on the engine's thread
+     * pool, tiles of rows are spread across the threads. The result is
+     * drawn like draw does: the character is replaced and the colors
+     * are blended.
+     * 
+     * @param shader callable taking (int x, int y) and returning a Cell,
+     * called concurrently from several threads
+     * @param rowsPerTile number of rows in a tile
+     */
+    template <typename F>
+    void forEachCell(F&& shader, int rowsPerTile = 2) {
+        CellBuffer& cells = *drawTarget;
+        getThreadPool().parallelFor(cells.getRows(), rowsPerTile, [&](int begin, int end) {
+            for (int y = begin; y < end; y ++) {
+                int index = cells.index(0, y);
+                Uint32* chs = cells.chs() + index;
+                SDL_Color* foreColors = cells.foreColors() + index;
+                SDL_Color* backColors = cells.backColors() + index;
+                for (int x = 0; x < cells.getCols(); x ++) {
+                    Cell cell = shader(x, y);
+                    chs[x] = cell.ch;
+                    foreColors[x] = blendColor(foreColors[x], cell.foreColor);
+                    backColors[x] = blendColor(backColors[x], cell.backColor);
+                }
+            }
+        });
+    }
+
+    /**
+     * @brief Get the thread pool used for parallel drawing, it is
+     * created with workerThreads threads on first use. In pipelined
+     * mode it is created before the render thread starts, so render
+     * and present never race on creating it
+     * 
+     * @return ThreadPool& 
+     */
+    ThreadPool& getThreadPool() {
+        if (!threadPool) {
+            threadPool.reset(new ThreadPool(workerThreads));
+        }
+        return *threadPool;
+    }
+
+    static constexpr int CONSOLE_LAYER = -1;    // the draw target of the console cells
+
+    /**
+     * @brief creates a transparent layer
+     * 
+     * @param z layers with negative z are drawn under the console
+     * cells, the others over them, in increasing z
+     * @param rows number of rows of cells, 0 for the console rows
+     * @param cols number of columns of cells, 0 for the console columns
+     * @return int the id of the layer
+     */
+    int createLayer(int z = 1, int rows = 0, int cols = 0) {
+        std::unique_ptr<CellLayer> layer(new CellLayer(rows > 0 ? rows : cellRows, cols > 0 ? cols : cellCols, z));
+        for (size_t i = 0; i < layers.size(); i ++) {
+            if (!layers[i]) {
+                layers[i] = std::move(layer);
+                layerBelow[i] = false;
+                return static_cast<int>(i);
+            }
+        }
+        layers.push_back(std::move(layer));
+        layerBelow.push_back(false);
+        return static_cast<int>(layers.size()) - 1;
+    }
+
+    /**
+     * @brief Get a layer
+     * 
+     * @param layer the id returned by createLayer
+     * @return CellLayer& 
+     */
+    CellLayer& getLayer(int layer) {
+        return *layers[layer];
+    }
+
+    /**
+     * @brief removes a layer, its id may be reused by createLayer
+     * 
+     * @param layer the id returned by createLayer
+     */
+    void removeLayer(int layer) {
+        if (layer < 0 || layer >= static_cast<int>(layers.size()) || !layers[layer]) {
+            return;
+        }
+        if (layerBelow[layer]) {
+            baseValid = false;
+        }
+        if (drawTargetLayer == layer) {
+            setDrawTarget(CONSOLE_LAYER);
+        }
+        layers[layer].reset();
+    }
+
+    /**
+     * @brief makes draw, drawLine, write, fill, forEachCell and the
+     * getters work on a layer, which is marked as changed. The target
+     * goes back to the console when the buffer is cleared and after
+     * render.
+     * 
+     * @param layer the id returned by createLayer, or CONSOLE_LAYER
+     */
+    void setDrawTarget(int layer) {
+        if (layer >= 0 && layer < static_cast<int>(layers.size()) && layers[layer]) {
+            layers[layer]->dirty = true;
+            drawTarget = &layers[layer]->cells;
+            drawTargetLayer = layer;
+        } else {
+            drawTarget = &buffer;
+            drawTargetLayer = CONSOLE_LAYER;
+        }
+    }
+
+    /**
+     * @brief Get the draw target
+     * 
+     * @return int the id of the layer, or CONSOLE_LAYER
+     */
+    int getDrawTarget() const {
+        return drawTargetLayer;
+    }
+
+    /**
+     * @brief start the game loop
+     * 
+     */
+    void init() {
+        loop = true;
+        gameLoop();
+    }
+
+    /**
+     * @brief clear buffer
+     * 
+     */
+    void clearBuffer() {
+        FrameProfiler::Scope scope(profiler, ProfilePhase::Clear);
+        clearCells();
+        if (renderer && renderBackend != RenderBackend::Software) {
+            SDL_RenderClear(renderer);
+        }
+    }
+
+    /**
+     * @brief render to the screen
+     * 
+     */
+    void renderBuffer() {
+        handOverCapture();
+        presentCells(buffer);
+    }
+
+    /**
+     * @brief captures the pixels of the frame being rendered, or of the
+     * next one when called from update, once it is presented. They can
+     * be read with getCapturedFrame afterwards, from update while
+     * pipelined. Not available in DisplayMode::Null.
+     * 
+     * @param path when not empty, the frame is also written to this file
+     * on a background thread
+     * @param format PNG, Raw, or Cells to write the cell planes instead
+     */
+    void captureFrame(std::string path = "", CaptureFormat format = CaptureFormat::PNG) {
+        nextCaptureRequested = true;
+        nextCapturePath = std::move(path);
+        nextCaptureFormat = format;
+    }
+
+    /**
+     * @brief Get the pixels captured by the last captureFrame. While
+     * pipelined, it is written during render, so call it from update.
+     * 
+     * @return const FrameCapture& frame is -1 if nothing was captured
+     */
+    const FrameCapture& getCapturedFrame() const {
+        return lastCapture;
+    }
+
+    /**
+     * @brief Get the cell planes of the current frame, a much cheaper
+     * capture than pixels. While pipelined, this is the frame being
+     * rendered, one ahead of the frame on screen.
+     * 
+     * @return const CellBuffer& 
+     */
+    const CellBuffer& getCells() const {
+        return buffer;
+    }
+
+    /**
+     * @brief waits until every captured frame is written to disk
+     * 
+     */
+    void flushCaptures() {
+        frameWriter.flush();
+    }
+
+    /**
+     * @brief Get the number of cells redrawn by the last renderBuffer,
+     * which is every cell unless retainedMode is on or the software
+     * backend skipped bands that did not change. While pipelined, the
+     * previous frame is presented during render, so call it from update.
+     * 
+     * @return int 
+     */
+    int getDirtyCellCount() const {
+        return dirtyCells;
+    }
+
+    /**
+     * @brief Get the number of bytes the last renderBuffer wrote to the
+     * terminal in DisplayMode::Terminal. Like getDirtyCellCount, call
+     * it from update while pipelined.
+     * 
+     * @return size_t 
+     */
+    size_t getTerminalBytes() const {
+        return terminalOutput.size();
+    }
+
+    /**
+     * @brief Get the number of frames since the game loop started
+     * 
+     * @return long 
+     */
+    long getFrameCount() const {
+        return frameCount;
+    }
+
+    /**
+     * @brief Get the frame arena, for memory that is only needed until
+     * the end of the frame, such as std::pmr::vector<T> v(getFrameArena())
+     * in update or render. Everything allocated from it is freed when the
+     * next frame starts. Not thread-safe: shaders of forEachCell must not
+     * allocate from it.
+     * 
+     * @return std::pmr::memory_resource* 
+     */
+    std::pmr::memory_resource* getFrameArena() {
+        return &frameArena;
+    }
+
+    /**
+     * @brief Get the pool, a thread-safe memory resource of size-classed
+     * pools for long-lived objects that are created and destroyed often
+     * 
+     * @return std::pmr::memory_resource* 
+     */
+    std::pmr::memory_resource* getPool() {
+        return &pool;
+    }
+
+    /**
+     * @brief Get the asset manager, which loads textures, cell images
+     * and sounds on a background thread. Acquire assets in start and
+     * check their state while drawing: the game runs while they load.
+     * 
+     * @return AssetManager& 
+     */
+    AssetManager& getAssets() {
+        return assets;
+    }
+
+    /**
+     * @brief replaces the tileset with another image of 16x16 glyphs,
+     * loaded in the background. The current tileset is drawn until the
+     * new one is loaded, and a failed load keeps it.
+     * 
+     * @param path the image of the tileset
+     */
+    void setTileset(const std::string& path) {
+        if (!renderer) {
+            return;
+        }
+        assets.release(pendingTileset);
+        pendingTileset = assets.acquire(path, AssetType::Texture);
+    }
+
+    /**
+     * @brief Get the frame profiler, whose statistics are only
+     * gathered while profiling is enabled
+     * 
+     * @return const FrameProfiler& 
+     */
+    const FrameProfiler& getProfiler() const {
+        return profiler;
+    }
+
+private:
+    /**
+     * @brief reads the hexadecimal color RRGGBB or RRGGBBAA at pos
+     * 
+     * @param text 
+     * @param pos 
+     * @param digits 6 or 8
+     * @param color the color read
+     * @return true if every digit is hexadecimal
+     */
+    static bool readHexColor(std::string_view text, size_t pos, size_t digits, SDL_Color& color) {
+        Uint32 value = 0;
+        for (size_t i = 0; i < digits; i ++) {
+            char c = text[pos + i] | 0x20;
+            int digit = '0' <= c && c <= '9' ? c - '0' : 'a' <= c && c <= 'f' ? c - 'a' + 10 : -1;
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | digit;
+        }
+        if (digits == 6) {
+            value = (value << 8) | 0xFF;
+        }
+        color = {static_cast<Uint8>(value >> 24), static_cast<Uint8>(value >> 16), static_cast<Uint8>(value >> 8), static_cast<Uint8>(value)};
+        return true;
+    }
+
+    /**
+     * @brief applies the markup tags at pos to style and moves pos past
+     * them
+     * 
+     * @param text 
+     * @param pos 
+     * @param style 
+     */
+    static void skipTextTags(std::string_view text, size_t& pos, TextStyle& style) {
+        while (pos < text.length() && text[pos] == '{') {
+            std::string_view tag = text.substr(pos, 13);    // up to {fg:RRGGBBAA}
+            if (tag.substr(0, 3) == "{/}") {
+                style.foreColor = style.baseForeColor;
+                style.backColor = style.baseBackColor;
+                pos += 3;
+                continue;
+            }
+            if (tag.length() < 11 || tag[3] != ':' || (tag.substr(1, 2) != "fg" && tag.substr(1, 2) != "bg")) {
+                return;
+            }
+            size_t digits = tag[10] == '}' ? 6 : tag.length() == 13 && tag[12] == '}' ? 8 : 0;
+            SDL_Color color;
+            if (digits == 0 || !readHexColor(tag, 4, digits, color)) {
+                return;
+            }
+            (tag[1] == 'f' ? style.foreColor : style.backColor) = color;
+            pos += digits + 5;
+        }
+    }
+
+    /**
+     * @brief decodes the character of writeText at pos, after its tags,
+     * and moves pos past it
+     * 
+     */
+    static Uint32 nextTextChar(std::string_view text, size_t& pos) {
+        if (text[pos] == '{' && pos + 1 < text.length() && text[pos + 1] == '{') {
+            pos += 2;
+            return '{';
+        }
+        return decodeUTF8(text, pos);
+    }
+
+    /**
+     * @brief lays out text in lines of width cells, calling
+     * emit(x, y, ch, foreColor, backColor) for each character other than
+     * a space with 0 <= x < width and y < maxLines
+     * 
+     * @param text 
+     * @param width 
+     * @param align 
+     * @param wrap 
+     * @param foreColor 
+     * @param backColor 
+     * @param maxLines lines after these are not laid out
+     * @param emit 
+     * @return SDL_Point (the width of the longest line, the number of lines)
+     */
+    template <typename Emit>
+    static SDL_Point layoutText(std::string_view text, int width, TextAlign align, bool wrap, SDL_Color foreColor, SDL_Color backColor, int maxLines, Emit&& emit) {
+        SDL_Point size = {0, 0};
+        if (width <= 0) {
+            return size;
+        }
+        TextStyle style = {foreColor, backColor, foreColor, backColor};
+        size_t start = 0;
+        while (start < text.length() && size.y < maxLines) {
+            // find where the line ends and where the next one starts
+            TextStyle scratch = style;
+            size_t pos = start;
+            size_t end = text.length();
+            size_t next = text.length();
+            size_t breakEnd = std::string_view::npos;
+            size_t breakNext = 0;
+            int breakCount = 0;
+            int count = 0;
+            while (true) {
+                skipTextTags(text, pos, scratch);
+                if (pos >= text.length()) {
+                    break;
+                }
+                size_t charStart = pos;
+                Uint32 ch = nextTextChar(text, pos);
+                if (ch == '\n') {
+                    end = charStart;
+                    next = pos;
+                    break;
+                }
+                if (wrap && count == width) {
+                    if (ch == ' ') {
+                        end = charStart;
+                        next = pos;
+                    } else if (breakEnd != std::string_view::npos) {
+                        end = breakEnd;
+                        next = breakNext;
+                        count = breakCount;
+                    } else {
+                        end = charStart;
+                        next = charStart;
+                    }
+                    break;
+                }
+                if (ch == ' ') {
+                    breakEnd = charStart;
+                    breakNext = pos;
+                    breakCount = count;
+                }
+                count ++;
+            }
+
+            int x = align == TextAlign::Left ? 0 : align == TextAlign::Center ? (width - count) / 2 : width - count;
+            pos = start;
+            while (true) {
+                skipTextTags(text, pos, style);
+                if (pos >= end) {
+                    break;
+                }
+                Uint32 ch = nextTextChar(text, pos);
+                if (ch != ' ' && 0 <= x && x < width) {
+                    emit(x, size.y, ch, style.foreColor, style.backColor);
+                }
+                x ++;
+            }
+            size.x = std::max(size.x, count);
+            size.y ++;
+            start = next;
+        }
+        return size;
+    }
+
+    /**
+     * @brief packs a color, alpha included, into 32 bits
+     * 
+     * @param color (r, g, b, a)
+     * @return Uint32 0xRRGGBBAA
+     */
+    static Uint32 packColor(SDL_Color color) {
+        return (static_cast<Uint32>(color.r) << 24) | (static_cast<Uint32>(color.g) << 16) | (static_cast<Uint32>(color.b) << 8) | color.a;
+    }
+
+    /**
+     * @brief finds the block of writeCachedText laid out with these
+     * parameters, laying it out if there is none
+     * 
+     * @return const CellImage& the laid-out cells, width columns wide
+     */
+    const CellImage& findTextBlock(std::string_view text, int width, TextAlign align, bool wrap, SDL_Color foreColor, SDL_Color backColor) {
+        Uint64 key = std::hash<std::string_view>()(text);
+        const Uint64 params[] = {static_cast<Uint64>(width), static_cast<Uint64>(align), wrap, packColor(foreColor), packColor(backColor)};
+        for (Uint64 param : params) {
+            key ^= param + 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2);
+        }
+        auto found = textBlocks.find(key);
+        if (found != textBlocks.end()) {
+            TextBlock& block = found->second;
+            if (block.text == text && block.width == width && block.align == align && block.wrap == wrap
+                && packColor(block.foreColor) == packColor(foreColor) && packColor(block.backColor) == packColor(backColor)) {
+                block.lastUsed = frameCount;
+                return block.image;
+            }
+        } else if (textBlocks.size() >= maxTextBlocks) {
+            for (auto it = textBlocks.begin(); it != textBlocks.end();) {
+                it = it->second.lastUsed < frameCount ? textBlocks.erase(it) : std::next(it);
+            }
+        }
+
+        // a new block, or a hash collision that replaces the old one
+        TextBlock& block = textBlocks[key];
+        block.text.assign(text.data(), text.length());
+        block.width = width;
+        block.align = align;
+        block.wrap = wrap;
+        block.foreColor = foreColor;
+        block.backColor = backColor;
+        block.lastUsed = frameCount;
+        SDL_Point size = measureText(text, width, wrap);
+        block.image.resize(size.y, width);
+        layoutText(text, width, align, wrap, foreColor, backColor, size.y, [&block](int x, int y, Uint32 ch, SDL_Color fore, SDL_Color back) {
+            block.image.set(x, y, ch, fore, back);
+        });
+        return block.image;
+    }
+
+    /**
+     * @brief fills the cells from x1 to x2 of row y, clipped to cells,
+     * taken as Sint64 so spans computed from ints cannot overflow
+     * 
+     * @param cells 
+     * @param x1 the first cell
+     * @param x2 the last cell
+     * @param y 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    static void drawSpan(CellBuffer& cells, Sint64 x1, Sint64 x2, Sint64 y, Uint32 ch, SDL_Color foreColor, SDL_Color backColor) {
+        if (y < 0 || y >= cells.getRows()) {
+            return;
+        }
+        x1 = std::max<Sint64>(x1, 0);
+        x2 = std::min<Sint64>(x2, cells.getCols() - 1);
+        if (x1 > x2) {
+            return;
+        }
+        int index = cells.index(static_cast<int>(x1), static_cast<int>(y));
+        int width = static_cast<int>(x2 - x1 + 1);
+        std::fill(cells.chs() + index, cells.chs() + index + width, ch);
+        blendColorSpan(cells.foreColors() + index, foreColor, width);
+        blendColorSpan(cells.backColors() + index, backColor, width);
+    }
+
+    /**
+     * @brief the Cohen-Sutherland region code of a cell
+     * 
+     * @return int a bit for each side of the target the cell is beyond
+     */
+    static int outCode(int x, int y, int cols, int rows) {
+        return (x < 0) | (x >= cols) << 1 | (y < 0) << 2 | (y >= rows) << 3;
+    }
+
+    /**
+     * @brief the steps t for which start + step * t lies in [0, size)
+     * 
+     */
+    static void stepRange(int start, int step, int size, Sint64& first, Sint64& last) {
+        first = step > 0 ? -static_cast<Sint64>(start) : static_cast<Sint64>(start) - (size - 1);
+        last = step > 0 ? static_cast<Sint64>(size) - 1 - start : start;
+    }
+
+    /**
+     * @brief draws the cells of the Bresenham line from (x1, y1) to
+     * (x2, y2) that lie in the draw target
+     * 
+     * Step k of the line advances the major axis by k and the minor axis
+     * by floor((2 * minor * k + major) / (2 * major)). The steps whose
+     * major coordinate is visible are solved for directly, the minor
+     * offset of the first one is found without overflowing, and the
+     * steps before the line enters the target along the minor axis are
+     * skipped, so the cells drawn are the same as those of the
+     * unclipped line.
+     * 
+     * @param x1 
+     * @param y1 
+     * @param x2 
+     * @param y2 
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     * @param drawLast whether (x2, y2) is drawn
+     */
+    void rasterizeLine(int x1, int y1, int x2, int y2, Uint32 ch, SDL_Color foreColor, SDL_Color backColor, bool drawLast) {
+        CellBuffer& cells = *drawTarget;
+        int cols = cells.getCols();
+        int rows = cells.getRows();
+        int code1 = outCode(x1, y1, cols, rows);
+        int code2 = outCode(x2, y2, cols, rows);
+        if (code1 & code2) {  // both ends beyond the same side
+            return;
+        }
+        Sint64 dx = static_cast<Sint64>(x2) - x1;
+        Sint64 dy = static_cast<Sint64>(y2) - y1;
+        Sint64 absX = dx < 0 ? -dx : dx;
+        Sint64 absY = dy < 0 ? -dy : dy;
+        bool xMajor = absX >= absY;
+        int major1 = xMajor ? x1 : y1;
+        int minor1 = xMajor ? y1 : x1;
+        Sint64 major = xMajor ? absX : absY;
+        Sint64 minor = xMajor ? absY : absX;
+        int majorStep = (xMajor ? dx : dy) > 0 ? 1 : -1;
+        int minorStep = (xMajor ? dy : dx) > 0 ? 1 : -1;
+        int minorSize = xMajor ? rows : cols;
+        Sint64 first = 0;
+        Sint64 last = drawLast ? major : major - 1;
+        if (code1 | code2) {
+            Sint64 majorFirst, majorLast;
+            stepRange(major1, majorStep, xMajor ? cols : rows, majorFirst, majorLast);
+            first = std::max(first, majorFirst);
+            last = std::min(last, majorLast);
+        }
+        if (first > last) {
+            return;
+        }
+
+        if (minor == 0) {
+            if (minor1 < 0 || minor1 >= minorSize) {
+                return;
+            }
+            Sint64 a = major1 + majorStep * first;
+            Sint64 b = major1 + majorStep * last;
+            if (xMajor) {   // horizontal
+                drawSpan(cells, std::min(a, b), std::max(a, b), minor1, ch, foreColor, backColor);
+                return;
+            }
+        }
+        // minor * first < 2^64 since both are below 2^32
+        Uint64 product = static_cast<Uint64>(minor) * static_cast<Uint64>(first);
+        Sint64 offset = static_cast<Sint64>(product / static_cast<Uint64>(major));
+        Sint64 remainder = 2 * static_cast<Sint64>(product % static_cast<Uint64>(major)) + major;
+        if (remainder >= 2 * major) {
+            remainder -= 2 * major;
+            offset ++;
+        }
+        Sint64 majorPos = major1 + majorStep * first;
+        Sint64 minorPos = minor1 + minorStep * offset;
+        // the minor axis is not clipped yet, skip to where the line enters
+        Sint64 k = first;
+        while (minorPos < 0 || minorPos >= minorSize) {
+            if ((minorStep > 0) == (minorPos >= minorSize) || k == last) {
+                return;     // past the target or ended before reaching it
+            }
+            k ++;
+            majorPos += majorStep;
+            remainder += 2 * minor;
+            if (remainder >= 2 * major) {
+                remainder -= 2 * major;
+                minorPos += minorStep;
+            }
+        }
+
+        int pitch = cells.index(0, 1);
+        int majorStride = xMajor ? majorStep : majorStep * pitch;
+        int minorStride = xMajor ? minorStep * pitch : minorStep;
+        int index = xMajor ? cells.index(static_cast<int>(majorPos), static_cast<int>(minorPos))
+            : cells.index(static_cast<int>(minorPos), static_cast<int>(majorPos));
+        int minorLeft = static_cast<int>(minorStep > 0 ? minorSize - 1 - minorPos : minorPos);  // minor steps before leaving the target
+        Uint32* chs = cells.chs();
+        SDL_Color* foreColors = cells.foreColors();
+        SDL_Color* backColors = cells.backColors();
+        for (; k <= last; k ++) {
+            chs[index] = ch;
+            foreColors[index] = blendColor(foreColors[index], foreColor);
+            backColors[index] = blendColor(backColors[index], backColor);
+            index += majorStride;
+            remainder += 2 * minor;
+            if (remainder >= 2 * major) {
+                if (minorLeft == 0) {
+                    return;
+                }
+                minorLeft --;
+                remainder -= 2 * major;
+                index += minorStride;
+            }
+        }
+    }
+
+    /**
+     * @brief the offsets dy of the rows of a circle that lie in cells
+     * 
+     * @param cells 
+     * @param y y-coordinate of the center
+     * @param radius 
+     * @param first the first dy, greater than last when no row is visible
+     * @param last the last dy
+     */
+    static void circleRows(const CellBuffer& cells, int y, int radius, Sint64& first, Sint64& last) {
+        first = std::max(-static_cast<Sint64>(radius), -static_cast<Sint64>(y));
+        last = std::min(static_cast<Sint64>(radius), static_cast<Sint64>(cells.getRows()) - 1 - y);
+    }
+
+    /**
+     * @brief the half width of the row dy cells from the center of a
+     * circle, the largest w with w * w + dy * dy <= radius * (radius + 1)
+     * 
+     */
+    static int circleHalfWidth(int radius, int dy) {
+        Sint64 limit = static_cast<Sint64>(radius) * (static_cast<Sint64>(radius) + 1) - static_cast<Sint64>(dy) * dy;
+        Sint64 w = static_cast<Sint64>(sqrt(static_cast<double>(limit)));
+        while (w * w > limit) {
+            w --;
+        }
+        while ((w + 1) * (w + 1) <= limit) {
+            w ++;
+        }
+        return static_cast<int>(w);
+    }
+
+    /**
+     * @brief fills the cells whose centers are inside a polygon or on
+     * its edges, with the even-odd rule
+     * 
+     * Each row is scanned with edges counted as half-open upwards and
+     * then downwards, and the union of the two is filled, so rows through
+     * a vertex or along a horizontal edge are covered.
+     * 
+     * @param points the vertices in cell coordinates
+     * @param count number of vertices
+     * @param ch 
+     * @param foreColor 
+     * @param backColor 
+     */
+    void rasterizePolygon(const SDL_FPoint* points, int count, Uint32 ch, SDL_Color foreColor, SDL_Color backColor) {
+        if (count < 1) {
+            return;
+        }
+        CellBuffer& cells = *drawTarget;
+        float top = points[0].y;
+        float bottom = points[0].y;
+        for (int i = 1; i < count; i ++) {
+            top = std::min(top, points[i].y);
+            bottom = std::max(bottom, points[i].y);
+        }
+        int firstRow = static_cast<int>(std::max(std::ceil(top), 0.0f));
+        int lastRow = static_cast<int>(std::min(std::floor(bottom), static_cast<float>(cells.getRows() - 1)));
+        for (int y = firstRow; y <= lastRow; y ++) {
+            polygonSpans.clear();
+            for (int downwards = 0; downwards < 2; downwards ++) {
+                polygonCrossings.clear();
+                for (int i = 0; i < count; i ++) {
+                    const SDL_FPoint& a = points[i];
+                    const SDL_FPoint& b = points[(i + 1) % count];
+                    double low = std::min(a.y, b.y);
+                    double high = std::max(a.y, b.y);
+                    if (downwards ? low < y && y <= high : low <= y && y < high) {
+                        polygonCrossings.push_back(a.x + (y - static_cast<double>(a.y)) * (b.x - a.x) / (static_cast<double>(b.y) - a.y));
+                    }
+                }
+                std::sort(polygonCrossings.begin(), polygonCrossings.end());
+                for (size_t i = 0; i + 1 < polygonCrossings.size(); i += 2) {
+                    double left = std::max(std::ceil(polygonCrossings[i]), -1.0);
+                    double right = std::min(std::floor(polygonCrossings[i + 1]), static_cast<double>(cells.getCols()));
+                    if (left <= right) {
+                        polygonSpans.push_back({static_cast<int>(left), static_cast<int>(right)});
+                    }
+                }
+            }
+            std::sort(polygonSpans.begin(), polygonSpans.end());
+            for (size_t i = 0; i < polygonSpans.size();) {
+                int left = polygonSpans[i].first;
+                int right = polygonSpans[i].second;
+                for (i ++; i < polygonSpans.size() && polygonSpans[i].first <= right + 1; i ++) {
+                    right = std::max(right, polygonSpans[i].second);
+                }
+                drawSpan(cells, left, right, y, ch, foreColor, backColor);
+            }
+        }
+    }
+
+    /**
+     * @brief renders cells to the screen
+     * 
+     * @param cells the buffer to present
+     */
+    void presentCells(const CellBuffer& cells) {
+        FrameProfiler::Scope scope(profiler, ProfilePhase::RenderBuffer);
+        if (displayMode == DisplayMode::Terminal) {
+            renderTerminal(cells);
+            captureCells(cells);
+            return;
+        }
+        if (!renderer) {
+            dirtyCells = cells.size();
+            captureCells(cells);
+            return;
+        }
+
+        if (glyphCache) {
+            glyphCache->beginFrame();
+        }
+        if (renderBackend == RenderBackend::Software) {
+            renderSoftware(cells);
+        } else {
+            renderHardware(cells);
+        }
+        captureCells(cells);
+        capturePixels();
+        FrameProfiler::Scope presentScope(profiler, ProfilePhase::Present);
+        SDL_RenderPresent(renderer);
+    }
+
+    /**
+     * @brief renders cells with the texture or geometry backend
+     * 
+     * @param cells the buffer to present
+     */
+    void renderHardware(const CellBuffer& cells) {
+        if (retainedMode && !frameTexture) {
+            frameTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, screenWidth, screenHeight);
+            if (!frameTexture) {
+                std::cerr << "Failed to create frame texture, retained mode disabled: " << SDL_GetError() << std::endl;
+                retainedMode = false;
+            } else {
+                SDL_SetTextureBlendMode(frameTexture, SDL_BLENDMODE_NONE);
+                frameValid = false;
+            }
+        }
+
+        if (retainedMode) {
+            SDL_SetRenderTarget(renderer, frameTexture);
+            renderDirtyCells(cells);
+            SDL_SetRenderTarget(renderer, nullptr);
+            SDL_RenderCopy(renderer, frameTexture, nullptr, nullptr);
+        } else {
+            renderCells(cells, indices);
+            dirtyCells = cells.size();
+        }
+    }
+
+    /**
+     * @brief rasterizes the cells into framePixels, or into frameSurface
+     * offscreen, in bands of bandRows rows on the thread pool, and
+     * uploads the rows that changed in one update of the streaming
+     * frameTexture. Bands whose cells did not change are skipped.
+     * 
+     * @param cells the buffer to present
+     */
+    void renderSoftware(const CellBuffer& cells) {
+        Uint32* pixels;
+        int pitch;  // in pixels
+        if (frameSurface) {
+            pixels = static_cast<Uint32*>(frameSurface->pixels);
+            pitch = frameSurface->pitch / 4;
+        } else {
+            if (!frameTexture) {
+                frameTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, screenWidth, screenHeight);
+                if (!frameTexture) {
+                    std::cerr << "Failed to create streaming texture, falling back to the geometry backend: " << SDL_GetError() << std::endl;
+                    renderBackend = RenderBackend::Geometry;
+                    SDL_RenderClear(renderer);
+                    renderHardware(cells);
+                    return;
+                }
+                SDL_SetTextureBlendMode(frameTexture, SDL_BLENDMODE_NONE);
+                framePixels.assign(static_cast<size_t>(screenWidth) * screenHeight, 0);
+                frameValid = false;
+            }
+            pixels = framePixels.data();
+            pitch = screenWidth;
+        }
+
+        int rowsPerBand = std::max(1, bandRows);
+        int numBands = (cellRows + rowsPerBand - 1) / rowsPerBand;
+        bandDirtyCells.assign(numBands, 0);
+
+        // glyphs of the font are looked up before the bands run in
+        // parallel. The cells past the tileset are found on the pool, only
+        // the lookups are serial since the glyph cache is not thread-safe.
+        if (glyphCache) {
+            Uint32 numTiles = static_cast<Uint32>(numSrcRows * numSrcCols);
+            cellGlyphs.resize(cells.size());
+            bandFontCells.assign(numBands, 0);
+            getThreadPool().parallelFor(numBands, 1, [&](int begin, int end) {
+                for (int band = begin; band < end; band ++) {
+                    int first = cells.index(0, band * rowsPerBand);
+                    int last = cells.index(0, std::min((band + 1) * rowsPerBand, cellRows));
+                    for (int index = first; index < last; index ++) {
+                        cellGlyphs[index] = nullptr;
+                        bandFontCells[band] += cells.chs()[index] >= numTiles;
+                    }
+                }
+            });
+            for (int band = 0; band < numBands; band ++) {
+                if (bandFontCells[band] == 0) {
+                    continue;
+                }
+                int first = cells.index(0, band * rowsPerBand);
+                int last = cells.index(0, std::min((band + 1) * rowsPerBand, cellRows));
+                for (int index = first; index < last; index ++) {
+                    Uint32 ch = cells.chs()[index];
+                    if (ch >= numTiles) {
+                        cellGlyphs[index] = findAtlasGlyph(ch);
+                    }
+                }
+            }
+        }
+        getThreadPool().parallelFor(numBands, 1, [&](int begin, int end) {
+            for (int band = begin; band < end; band ++) {
+                int firstRow = band * rowsPerBand;
+                bandDirtyCells[band] = rasterizeBand(cells, firstRow, std::min(firstRow + rowsPerBand, cellRows), pixels, pitch);
+            }
+        });
+        frameValid = true;
+
+        int firstBand = numBands;
+        int lastBand = -1;
+        dirtyCells = 0;
+        for (int band = 0; band < numBands; band ++) {
+            if (bandDirtyCells[band] > 0) {
+                firstBand = std::min(firstBand, band);
+                lastBand = band;
+                dirtyCells += bandDirtyCells[band];
+            }
+        }
+        if (frameTexture) {
+            if (lastBand >= firstBand) {
+                int top = firstBand * rowsPerBand * cellHeight;
+                int bottom = std::min((lastBand + 1) * rowsPerBand, cellRows) * cellHeight;
+                SDL_Rect rows = {0, top, screenWidth, bottom - top};
+                SDL_UpdateTexture(frameTexture, &rows, pixels + top * pitch, pitch * 4);
+            }
+            SDL_RenderCopy(renderer, frameTexture, nullptr, nullptr);
+        }
+    }
+
+    /**
+     * @brief rasterizes a band of rows unless its cells equal those of
+     * prevBuffer, in which case its pixels are still up to date. In
+     * retained mode only the cells of the band that changed are
+     * rasterized again. Bands are disjoint, so they can run on
+     * different threads.
+     * 
+     * @param cells the buffer being presented
+     * @param firstRow the first row of cells of the band
+     * @param endRow the row after the band
+     * @param pixels the top-left pixel of the frame
+     * @param pitch pixels from a row to the next
+     * @return int the number of cells rasterized
+     */
+    int rasterizeBand(const CellBuffer& cells, int firstRow, int endRow, Uint32* pixels, int pitch) {
+        int begin = cells.index(0, firstRow);
+        int count = cells.index(0, endRow) - begin;
+        const Uint32* chs = cells.chs() + begin;
+        const SDL_Color* foreColors = cells.foreColors() + begin;
+        const SDL_Color* backColors = cells.backColors() + begin;
+        Uint32* prevChs = prevBuffer.chs() + begin;
+        SDL_Color* prevForeColors = prevBuffer.foreColors() + begin;
+        SDL_Color* prevBackColors = prevBuffer.backColors() + begin;
+        if (frameValid && memcmp(chs, prevChs, count * sizeof(Uint32)) == 0
+            && memcmp(foreColors, prevForeColors, count * sizeof(SDL_Color)) == 0
+            && memcmp(backColors, prevBackColors, count * sizeof(SDL_Color)) == 0) {
+            return 0;
+        }
+
+        bool retained = retainedMode && frameValid;
+        int rasterized = 0;
+        for (int i = 0; i < count; i ++) {
+            if (retained && chs[i] == prevChs[i]
+                && equalColor(foreColors[i], prevForeColors[i])
+                && equalColor(backColors[i], prevBackColors[i])) {
+                continue;
+            }
+            int row = firstRow + i / cellCols;
+            int col = i % cellCols;
+            rasterizeCell(cells, begin + i, pixels + row * cellHeight * pitch + col * cellWidth, pitch);
+            rasterized ++;
+        }
+        memcpy(prevChs, chs, count * sizeof(Uint32));
+        memcpy(prevForeColors, foreColors, count * sizeof(SDL_Color));
+        memcpy(prevBackColors, backColors, count * sizeof(SDL_Color));
+        return rasterized;
+    }
+
+    /**
+     * @brief draws a cell into ARGB8888 pixels like the texture backend
+     * does over the black clear color: the background over black, then
+     * the glyph tinted by the fore color over the background
+     * 
+     * @param cells the buffer being presented
+     * @param index the plane index of the cell
+     * @param dest the top-left pixel of the cell
+     * @param pitch pixels from a row to the next
+     */
+    void rasterizeCell(const CellBuffer& cells, int index, Uint32* dest, int pitch) {
+        SDL_Color back = blendColor({0, 0, 0, 255}, cells.backColors()[index]);
+        SDL_Color fore = cells.foreColors()[index];
+        Uint32 backPixel = packPixel(back);
+        Uint32 ch = cells.chs()[index];
+        const GlyphCache::Glyph* glyph = nullptr;
+        if (ch >= static_cast<Uint32>(numSrcRows * numSrcCols)) {
+            glyph = glyphCache ? cellGlyphs[index] : nullptr;
+            ch = '?';
+        }
+
+        if (fore.a == 0) {
+            for (int y = 0; y < cellHeight; y ++) {
+                std::fill(dest + y * pitch, dest + y * pitch + cellWidth, backPixel);
+            }
+        } else if (glyph) {
+            const Uint8* mask = glyphCache->getMask(*glyph);
+            for (int y = 0; y < cellHeight; y ++) {
+                blendGlyphRow(dest + y * pitch, mask + y * glyphCache->getPageSize(), cellWidth, back, fore);
+            }
+        } else {
+            const Uint8* mask = tileMasks.data() + static_cast<size_t>(ch) * cellWidth * cellHeight;
+            if (binaryTileMasks) {
+                Uint32 forePixel = packPixel(blendColor(back, fore));
+                for (int y = 0; y < cellHeight; y ++) {
+                    selectGlyphRow(dest + y * pitch, mask + y * cellWidth, cellWidth, backPixel, forePixel);
+                }
+            } else {
+                for (int y = 0; y < cellHeight; y ++) {
+                    blendGlyphRow(dest + y * pitch, mask + y * cellWidth, cellWidth, back, fore);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief packs an opaque color into an ARGB8888 pixel
+     * 
+     * @param color (r, g, b, a)
+     * @return Uint32 
+     */
+    static inline Uint32 packPixel(SDL_Color color) {
+        return 0xFF000000u | (static_cast<Uint32>(color.r) << 16) | (static_cast<Uint32>(color.g) << 8) | color.b;
+    }
+
+    /**
+     * @brief expands a row of a 1-bit glyph, dest[i] is forePixel where
+     * coverage[i] is 255 and backPixel where it is 0
+     * 
+     * @param dest 
+     * @param coverage 
+     * @param width 
+     * @param backPixel 
+     * @param forePixel 
+     */
+    static void selectGlyphRow(Uint32* dest, const Uint8* coverage, int width, Uint32 backPixel, Uint32 forePixel) {
+        int i = 0;
+#if defined(RCE_AVX2) || defined(RCE_SSE2)
+        const __m128i back = _mm_set1_epi32(static_cast<int>(backPixel));
+        const __m128i fore = _mm_set1_epi32(static_cast<int>(forePixel));
+        for (; i + 4 <= width; i += 4) {
+            Uint32 bytes;
+            memcpy(&bytes, coverage + i, 4);
+            __m128i mask = _mm_cvtsi32_si128(static_cast<int>(bytes));
+            mask = _mm_unpacklo_epi16(_mm_unpacklo_epi8(mask, mask), _mm_unpacklo_epi8(mask, mask));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_or_si128(_mm_and_si128(mask, fore), _mm_andnot_si128(mask, back)));
+        }
+#endif
+        for (; i < width; i ++) {
+            dest[i] = coverage[i] ? forePixel : backPixel;
+        }
+    }
+
+    /**
+     * @brief blends a row of an 8-bit glyph, dest[i] is fore with its
+     * alpha scaled by coverage[i] over the opaque back
+     * 
+     * @param dest 
+     * @param coverage 
+     * @param width 
+     * @param back (r, g, b, 255)
+     * @param fore (r, g, b, a)
+     */
+    static void blendGlyphRow(Uint32* dest, const Uint8* coverage, int width, SDL_Color back, SDL_Color fore) {
+        int i = 0;
+#if defined(RCE_AVX2) || defined(RCE_SSE2)
+        // two pixels per register in 16-bit lanes, in the b, g, r, a order of ARGB8888
+        const __m128i backLanes = _mm_setr_epi16(back.b, back.g, back.r, 255, back.b, back.g, back.r, 255);
+        const __m128i foreLanes = _mm_setr_epi16(fore.b, fore.g, fore.r, 255, fore.b, fore.g, fore.r, 255);
+        const __m128i foreAlpha = _mm_set1_epi16(fore.a);
+        const __m128i rounding = _mm_set1_epi16(128);
+        const __m128i full = _mm_set1_epi16(255);
+        for (; i + 4 <= width; i += 4) {
+            Uint32 bytes;
+            memcpy(&bytes, coverage + i, 4);
+            __m128i alpha = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(bytes)), _mm_setzero_si128());
+            alpha = _mm_unpacklo_epi16(alpha, alpha);
+            __m128i halves[2] = {_mm_unpacklo_epi32(alpha, alpha), _mm_unpackhi_epi32(alpha, alpha)};
+            for (__m128i& lanes : halves) {
+                // div255(coverage * fore.a), then div255(fore * alpha + back * (255 - alpha))
+                __m128i x = _mm_add_epi16(_mm_mullo_epi16(lanes, foreAlpha), rounding);
+                lanes = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+                x = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(foreLanes, lanes), _mm_mullo_epi16(backLanes, _mm_sub_epi16(full, lanes))), rounding);
+                lanes = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packus_epi16(halves[0], halves[1]));
+        }
+#endif
+        for (; i < width; i ++) {
+            Uint8 alpha = div255(coverage[i] * fore.a);
+            dest[i] = packPixel(blendColor(back, {fore.r, fore.g, fore.b, alpha}));
+        }
+    }
+
+    /**
+     * @brief takes the texture and glyph size of the tileset from
+     * tilesetAsset, and decodes it for the software backend
+     * 
+     * @return true 
+     * @return false if the software backend cannot decode it
+     */
+    bool applyTileset() {
+        SDL_Surface* surface = assets.getSurface(tilesetAsset);
+        tileset = assets.getTexture(tilesetAsset);
+        tilesetVersion = assets.getVersion(tilesetAsset);
+        tileWidth = surface->w / numSrcCols;
+        tileHeight = surface->h / numSrcRows;
+        return renderBackend != RenderBackend::Software || decodeTileset(surface);
+    }
+
+    /**
+     * @brief switches to the tileset of setTileset once it is loaded,
+     * and rebuilds the geometry when the tileset in use was reloaded
+     * 
+     */
+    void updateTileset() {
+        if (pendingTileset >= 0 && assets.getState(pendingTileset) != AssetState::Loading) {
+            if (assets.getTexture(pendingTileset)) {
+                std::swap(tilesetAsset, pendingTileset);
+                tilesetVersion = 0;
+            }
+            assets.release(pendingTileset);
+            pendingTileset = -1;
+        }
+        if (tilesetAsset < 0 || assets.getVersion(tilesetAsset) == tilesetVersion) {
+            return;
+        }
+        if (!applyTileset()) {
+            std::cerr << "Failed to decode the tileset: " << SDL_GetError() << std::endl;
+        }
+        initGeometry();
+        frameValid = false;
+    }
+
+    /**
+     * @brief reads the coverage of the tileset glyphs from its alpha,
+     * scaled to the cell size by nearest sampling as SDL scales blits.
+     * Glyph pixels are white, as the fore color tints them, and the
+     * magenta color key is transparent.
+     * 
+     * @param surface the tileset
+     * @return true 
+     * @return false if the surface cannot be converted
+     */
+    bool decodeTileset(SDL_Surface* surface) {
+        SDL_Surface* argb = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        if (!argb) {
+            return false;
+        }
+        int numGlyphs = numSrcRows * numSrcCols;
+        int stepX = (tileWidth << 16) / cellWidth;
+        int stepY = (tileHeight << 16) / cellHeight;
+        tileMasks.assign(static_cast<size_t>(numGlyphs) * cellWidth * cellHeight, 0);
+        binaryTileMasks = true;
+        for (int ch = 0; ch < numGlyphs; ch ++) {
+            Uint8* mask = tileMasks.data() + static_cast<size_t>(ch) * cellWidth * cellHeight;
+            int tileX = (ch % numSrcCols) * tileWidth;
+            int tileY = (ch / numSrcCols) * tileHeight;
+            for (int y = 0; y < cellHeight; y ++) {
+                int srcY = tileY + ((stepY / 2 + y * stepY) >> 16);
+                const Uint32* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(argb->pixels) + srcY * argb->pitch);
+                for (int x = 0; x < cellWidth; x ++) {
+                    Uint32 pixel = row[tileX + ((stepX / 2 + x * stepX) >> 16)];
+                    Uint8 coverage = (pixel & 0xFFFFFF) == 0xFF00FF ? 0 : static_cast<Uint8>(pixel >> 24);
+                    mask[y * cellWidth + x] = coverage;
+                    binaryTileMasks = binaryTileMasks && (coverage == 0 || coverage == 255);
+                }
+            }
+        }
+        SDL_FreeSurface(argb);
+        return true;
+    }
+
+    static constexpr Uint32 NO_COLOR = 0xFFFFFFFF;
+    static constexpr int TERMINAL_GAP = 4;  // unchanged cells rewritten to join two changed runs instead of moving the cursor
+
+    /**
+     * @brief writes the cells that differ from prevBuffer to stdout
+     * with writeTerminal. The cursor is moved only where a run of
+     * changed cells starts, short gaps between runs are rewritten
+     * instead, and colors are only sent when they differ from the
+     * current ones.
+     * 
+     * @param cells the buffer to present
+     */
+    void renderTerminal(const CellBuffer& cells) {
+        const Uint32* chs = cells.chs();
+        const SDL_Color* foreColors = cells.foreColors();
+        const SDL_Color* backColors = cells.backColors();
+        Uint32* prevChs = prevBuffer.chs();
+        SDL_Color* prevForeColors = prevBuffer.foreColors();
+        SDL_Color* prevBackColors = prevBuffer.backColors();
+
+        terminalOutput.clear();
+        dirtyCells = 0;
+        if (!frameValid) {
+            terminalX = -1;
+            terminalY = -1;
+            terminalFore = NO_COLOR;
+            terminalBack = NO_COLOR;
+        }
+        for (int i = 0; i < cellRows; i ++) {
+            int lastWritten = -1;   // the last column written in this row
+            for (int j = 0; j < cellCols; j ++) {
+                int index = cells.index(j, i);
+                if (frameValid && chs[index] == prevChs[index]
+                    && equalColor(foreColors[index], prevForeColors[index])
+                    && equalColor(backColors[index], prevBackColors[index])) {
+                    continue;
+                }
+                if (terminalY == i && lastWritten >= 0 && terminalX == lastWritten + 1 && j - terminalX <= TERMINAL_GAP
+                    && std::all_of(chs + cells.index(terminalX, i), chs + index, [](Uint32 ch) { return !isWide(ch); })) {
+                    for (int k = terminalX; k < j; k ++) {
+                        writeTerminalCell(cells, cells.index(k, i));
+                    }
+                } else if (terminalY != i || terminalX != j) {
+                    terminalOutput += "\x1b[";
+                    appendNumber(terminalOutput, i + 1);
+                    terminalOutput += ';';
+                    appendNumber(terminalOutput, j + 1);
+                    terminalOutput += 'H';
+                    terminalY = i;
+                }
+                writeTerminalCell(cells, index);
+                prevChs[index] = chs[index];
+                prevForeColors[index] = foreColors[index];
+                prevBackColors[index] = backColors[index];
+                lastWritten = j;
+                dirtyCells ++;
+            }
+        }
+        frameValid = true;
+        writeTerminal(terminalOutput.data(), terminalOutput.size());
+    }
+
+    /**
+     * @brief writes bytes to stdout, with one write call where the
+     * system takes them at once, however large the frame is
+     * 
+     * @param data 
+     * @param size 
+     */
+    static void writeTerminal(const char* data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        // anything the game printed through stdio goes first
+        fflush(stdout);
+#if defined(RCE_POSIX_WRITE)
+        while (size > 0) {
+            ssize_t written = ::write(STDOUT_FILENO, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+#else
+        fwrite(data, 1, size, stdout);
+        fflush(stdout);
+#endif
+    }
+
+    /**
+     * @brief switches the terminal to the alternate screen and hides the
+     * cursor, restoreTerminal undoes it and also runs at exit
+     * 
+     */
+    static void enterTerminal() {
+        static bool registered = false;
+        if (!registered) {
+            registered = std::atexit(restoreTerminal) == 0;
+        }
+        if (!terminalScreen.exchange(true)) {
+            const char enter[] = "\x1b[?1049h\x1b[?25l\x1b[0m\x1b[2J";
+            writeTerminal(enter, sizeof(enter) - 1);
+        }
+    }
+
+    /**
+     * @brief leaves the alternate screen and shows the cursor, does
+     * nothing unless enterTerminal switched to it
+     * 
+     */
+    static void restoreTerminal() {
+        if (terminalScreen.exchange(false)) {
+            const char restore[] = "\x1b[0m\x1b[?25h\x1b[?1049l";
+            writeTerminal(restore, sizeof(restore) - 1);
+        }
+    }
+
+    /**
+     * @brief appends a cell at the terminal cursor to terminalOutput
+     * with the colors the texture backend would show, the background
+     * over black and the fore color over the background
+     * 
+     * @param cells the buffer being presented
+     * @param index the plane index of the cell
+     */
+    void writeTerminalCell(const CellBuffer& cells, int index) {
+        SDL_Color back = blendColor({0, 0, 0, 255}, cells.backColors()[index]);
+        Uint32 ch = cells.chs()[index];
+        Uint32 codePoint = ch < 256 ? cp437ToUnicode(static_cast<Uint8>(ch)) : ch;
+        Uint32 backColor = (back.r << 16) | (back.g << 8) | back.b;
+        Uint32 foreColor = terminalFore;
+        if (codePoint != ' ' && codePoint != 0xA0) {
+            SDL_Color fore = blendColor(back, cells.foreColors()[index]);
+            foreColor = (fore.r << 16) | (fore.g << 8) | fore.b;
+        }
+        if (foreColor != terminalFore || backColor != terminalBack) {
+            terminalOutput += "\x1b[";
+            if (foreColor != terminalFore) {
+                terminalOutput += "38;2;";
+                appendColor(terminalOutput, foreColor);
+                terminalFore = foreColor;
+                if (backColor != terminalBack) {
+                    terminalOutput += ';';
+                }
+            }
+            if (backColor != terminalBack) {
+                terminalOutput += "48;2;";
+                appendColor(terminalOutput, backColor);
+                terminalBack = backColor;
+            }
+            terminalOutput += 'm';
+        }
+        appendUTF8(terminalOutput, codePoint);
+        // wide characters move the cursor by two columns
+        terminalX = !isWide(codePoint) ? (index % cellCols) + 1 : -1;
+    }
+
+    /**
+     * @brief tells if terminals draw a character two columns wide, for
+     * the main East Asian and emoji blocks
+     * 
+     * @param codePoint 
+     * @return true 
+     * @return false 
+     */
+    static bool isWide(Uint32 codePoint) {
+        return (0x1100 <= codePoint && codePoint <= 0x115F) || (0x2E80 <= codePoint && codePoint <= 0xA4CF && codePoint != 0x303F)
+            || (0xAC00 <= codePoint && codePoint <= 0xD7A3) || (0xF900 <= codePoint && codePoint <= 0xFAFF)
+            || (0xFE30 <= codePoint && codePoint <= 0xFE4F) || (0xFF00 <= codePoint && codePoint <= 0xFF60)
+            || (0xFFE0 <= codePoint && codePoint <= 0xFFE6) || (0x1F300 <= codePoint && codePoint <= 0x1F64F)
+            || (0x1F900 <= codePoint && codePoint <= 0x1F9FF) || (0x20000 <= codePoint && codePoint <= 0x3FFFD);
+    }
+
+    /**
+     * @brief appends a non-negative number in decimal
+     * 
+     * @param text 
+     * @param number 
+     */
+    static void appendNumber(std::string& text, int number) {
+        char digits[12];
+        int count = 0;
+        do {
+            digits[count ++] = static_cast<char>('0' + number % 10);
+            number /= 10;
+        } while (number > 0);
+        while (count > 0) {
+            text += digits[-- count];
+        }
+    }
+
+    /**
+     * @brief appends the r;g;b parameters of a color
+     * 
+     * @param text 
+     * @param color 0xRRGGBB
+     */
+    static void appendColor(std::string& text, Uint32 color) {
+        appendNumber(text, (color >> 16) & 0xFF);
+        text += ';';
+        appendNumber(text, (color >> 8) & 0xFF);
+        text += ';';
+        appendNumber(text, color & 0xFF);
+    }
+
+    /**
+     * @brief appends a code point encoded in UTF-8
+     * 
+     * @param text 
+     * @param codePoint 
+     */
+    static void appendUTF8(std::string& text, Uint32 codePoint) {
+        if (codePoint < 0x80) {
+            text += static_cast<char>(codePoint);
+        } else if (codePoint < 0x800) {
+            text += static_cast<char>(0xC0 | (codePoint >> 6));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            text += static_cast<char>(0xE0 | (codePoint >> 12));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (codePoint >> 18));
+            text += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    /**
+     * @brief Get the Unicode character drawn by a glyph of the CP437
+     * tileset
+     * 
+     * @param ch 
+     * @return Uint32 the code point, a space for 0
+     */
+    static Uint32 cp437ToUnicode(Uint8 ch) {
+        static const Uint16 low[32] = {
+            0x0020, 0x263A, 0x263B, 0x2665, 0x2666, 0x2663, 0x2660, 0x2022, 0x25D8, 0x25CB, 0x25D9, 0x2642, 0x2640, 0x266A, 0x266B, 0x263C,
+            0x25BA, 0x25C4, 0x2195, 0x203C, 0x00B6, 0x00A7, 0x25AC, 0x21A8, 0x2191, 0x2193, 0x2192, 0x2190, 0x221F, 0x2194, 0x25B2, 0x25BC
+        };
+        static const Uint16 high[129] = {
+            0x2302,
+            0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7, 0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,
+            0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9, 0x00FF, 0x00D6, 0x00DC, 0x00A2, 0x00A3, 0x00A5, 0x20A7, 0x0192,
+            0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA, 0x00BF, 0x2310, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,
+            0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556, 0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+            0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F, 0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+            0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B, 0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+            0x03B1, 0x00DF, 0x0393, 0x03C0, 0x03A3, 0x03C3, 0x00B5, 0x03C4, 0x03A6, 0x0398, 0x03A9, 0x03B4, 0x221E, 0x03C6, 0x03B5, 0x2229,
+            0x2261, 0x00B1, 0x2265, 0x2264, 0x2320, 0x2321, 0x00F7, 0x2248, 0x00B0, 0x2219, 0x00B7, 0x221A, 0x207F, 0x00B2, 0x25A0, 0x00A0
+        };
+        if (ch < 32) {
+            return low[ch];
+        }
+        return ch < 127 ? ch : high[ch - 127];
+    }
+
+    /**
+     * @brief divides x in [0, 255 * 255] by 255 with rounding
+     * 
+     * @param x 
+     * @return Uint8 
+     */
+    static inline Uint8 div255(int x) {
+        x += 128;
+        return static_cast<Uint8>((x + (x >> 8)) >> 8);
+    }
+
+#if defined(RCE_AVX2)
+    /**
+     * @brief blends 16-bit channels over opaque ones,
+     * div255(srcTerm + dest * inverse) in every lane
+     * 
+     */
+    static inline __m256i blendLanes(__m256i dest, __m256i srcTerm, __m256i inverse) {
+        __m256i x = _mm256_add_epi16(_mm256_add_epi16(srcTerm, _mm256_mullo_epi16(dest, inverse)), _mm256_set1_epi16(128));
+        return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+    }
+#elif defined(RCE_SSE2)
+    /**
+     * @brief blends 16-bit channels over opaque ones,
+     * div255(srcTerm + dest * inverse) in every lane
+     * 
+     */
+    static inline __m128i blendLanes(__m128i dest, __m128i srcTerm, __m128i inverse) {
+        __m128i x = _mm_add_epi16(_mm_add_epi16(srcTerm, _mm_mullo_epi16(dest, inverse)), _mm_set1_epi16(128));
+        return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+    }
+#endif
+
+    /**
+     * @brief Get the path of a periodic capture of the current frame
+     * 
+     * @param format 
+     * @return std::string 
+     */
+    std::string capturePathOf(CaptureFormat format) const {
+        char suffix[32];
+        const char* extension = format == CaptureFormat::PNG ? "png" : (format == CaptureFormat::Raw ? "raw" : "cells");
+        snprintf(suffix, sizeof(suffix), "_%06ld.%s", presentedFrame, extension);
+        return capturePath + suffix;
+    }
+
+    /**
+     * @brief hands the capture requested while the current frame was
+     * made to present, together with the frame number. While pipelined
+     * it runs after waitRender, when the render thread is idle.
+     * 
+     */
+    void handOverCapture() {
+        presentedFrame = frameCount;
+        captureRequested = nextCaptureRequested;
+        requestedCapturePath = std::move(nextCapturePath);
+        requestedCaptureFormat = nextCaptureFormat;
+        nextCaptureRequested = false;
+        nextCapturePath.clear();
+    }
+
+    /**
+     * @brief queues the cell planes for writing when a cell capture
+     * is due this frame
+     * 
+     * @param cells the buffer being presented
+     */
+    void captureCells(const CellBuffer& cells) {
+        if (captureInterval > 0 && captureFormat == CaptureFormat::Cells && presentedFrame % captureInterval == 0) {
+            frameWriter.push(capturePathOf(CaptureFormat::Cells), cells);
+        }
+        if (captureRequested && requestedCaptureFormat == CaptureFormat::Cells) {
+            captureRequested = false;
+            if (!requestedCapturePath.empty()) {
+                frameWriter.push(requestedCapturePath, cells);
+            }
+        }
+    }
+
+    /**
+     * @brief reads the pixels of the composed frame before it is
+     * presented when a capture is due this frame
+     * 
+     */
+    void capturePixels() {
+        bool periodic = captureInterval > 0 && captureFormat != CaptureFormat::Cells && presentedFrame % captureInterval == 0;
+        if (!periodic && !captureRequested) {
+            return;
+        }
+
+        std::vector<Uint32> pixels = frameWriter.acquirePixels(screenWidth * screenHeight);
+        if (SDL_RenderReadPixels(renderer, nullptr, SDL_PIXELFORMAT_ARGB8888, pixels.data(), screenWidth * 4) < 0) {
+            std::cerr << "Failed to read frame pixels: " << SDL_GetError() << std::endl;
+            captureRequested = false;
+            return;
+        }
+        if (captureRequested) {
+            captureRequested = false;
+            lastCapture.frame = presentedFrame;
+            lastCapture.width = screenWidth;
+            lastCapture.height = screenHeight;
+            lastCapture.pixels.assign(pixels.begin(), pixels.end());
+            if (!requestedCapturePath.empty()) {
+                std::vector<Uint32> copy = frameWriter.acquirePixels(0);
+                copy.assign(pixels.begin(), pixels.end());
+                frameWriter.push(requestedCapturePath, requestedCaptureFormat, screenWidth, screenHeight, std::move(copy));
+            }
+        }
+        if (periodic) {
+            frameWriter.push(capturePathOf(captureFormat), captureFormat, screenWidth, screenHeight, std::move(pixels));
+        }
+    }
+
+    /**
+     * @brief builds the parts of the vertex and index streams that
+     * do not change between frames
+     * 
+     */
+    void initGeometry() {
+        int numCells = buffer.size();
+        int textureWidth = numSrcCols * tileWidth;
+        int textureHeight = numSrcRows * tileHeight;
+        SDL_QueryTexture(tileset, nullptr, nullptr, &textureWidth, &textureHeight);
+        tileTexSize = {static_cast<float>(tileWidth) / textureWidth, static_cast<float>(tileHeight) / textureHeight};
+
+        glyphTexCoords = std::vector<SDL_FPoint>(numSrcRows * numSrcCols);
+        for (int ch = 0; ch < numSrcRows * numSrcCols; ch ++) {
+            glyphTexCoords[ch] = {(ch % numSrcCols) * tileTexSize.x, (ch / numSrcCols) * tileTexSize.y};
+        }
+        SDL_FPoint backTexCoord = glyphTexCoords[219];
+
+        glyphPage = std::vector<int>(numCells, -1);
+        vertices = std::vector<SDL_Vertex>(numCells * 8);
+        indices = std::vector<int>(numCells * 12);
+        for (int quad = 0; quad < numCells * 2; quad ++) {
+            int index = quad % numCells;
+            float x = static_cast<float>((index % cellCols) * cellWidth);
+            float y = static_cast<float>((index / cellCols) * cellHeight);
+            SDL_Vertex* quadVertices = &vertices[quad * 4];
+            quadVertices[0].position = {x, y};
+            quadVertices[1].position = {x + cellWidth, y};
+            quadVertices[2].position = {x, y + cellHeight};
+            quadVertices[3].position = {x + cellWidth, y + cellHeight};
+            if (quad < numCells) {
+                setQuadTexCoords(quadVertices, backTexCoord, tileTexSize);
+            }
+            int* quadIndices = &indices[quad * 6];
+            quadIndices[0] = quad * 4;
+            quadIndices[1] = quad * 4 + 1;
+            quadIndices[2] = quad * 4 + 2;
+            quadIndices[3] = quad * 4 + 2;
+            quadIndices[4] = quad * 4 + 1;
+            quadIndices[5] = quad * 4 + 3;
+        }
+    }
+
+    /**
+     * @brief Set the uv of a quad to the glyph starting at texCoord
+     * 
+     * @param quadVertices the 4 vertices of the quad
+     * @param texCoord the top-left uv of the glyph
+     * @param texSize the size of the glyph in uv space
+     */
+    inline void setQuadTexCoords(SDL_Vertex* quadVertices, SDL_FPoint texCoord, SDL_FPoint texSize) {
+        quadVertices[0].tex_coord = texCoord;
+        quadVertices[1].tex_coord = {texCoord.x + texSize.x, texCoord.y};
+        quadVertices[2].tex_coord = {texCoord.x, texCoord.y + texSize.y};
+        quadVertices[3].tex_coord = {texCoord.x + texSize.x, texCoord.y + texSize.y};
+    }
+
+    /**
+     * @brief Get the glyph of a code point past the tileset from the
+     * glyph cache
+     * 
+     * @param ch code point
+     * @return const GlyphCache::Glyph* nullptr if there is no font or
+     * the glyph cannot be rasterized, the tileset '?' is drawn instead
+     */
+    inline const GlyphCache::Glyph* findAtlasGlyph(Uint32 ch) {
+        return glyphCache ? glyphCache->find(ch) : nullptr;
+    }
+
+    /**
+     * @brief Set the vertex color of a quad
+     * 
+     * @param quadVertices the 4 vertices of the quad
+     * @param color (r, g, b, a)
+     */
+    inline void setQuadColor(SDL_Vertex* quadVertices, SDL_Color color) {
+        quadVertices[0].color = color;
+        quadVertices[1].color = color;
+        quadVertices[2].color = color;
+        quadVertices[3].color = color;
+    }
+
+    /**
+     * @brief refreshes the colors and glyph uv of a cell in the
+     * vertex stream
+     * 
+     * @param cells the buffer being presented
+     * @param index the plane index of the cell
+     */
+    inline void updateCellVertices(const CellBuffer& cells, int index) {
+        SDL_Vertex* backVertices = &vertices[index * 4];
+        SDL_Vertex* glyphVertices = &vertices[(cells.size() + index) * 4];
+        setQuadColor(backVertices, cells.backColors()[index]);
+        setQuadColor(glyphVertices, cells.foreColors()[index]);
+        Uint32 ch = cells.chs()[index];
+        glyphPage[index] = -1;
+        if (ch < glyphTexCoords.size()) {
+            setQuadTexCoords(glyphVertices, glyphTexCoords[ch], tileTexSize);
+        } else if (const GlyphCache::Glyph* glyph = findAtlasGlyph(ch)) {
+            float pageSize = static_cast<float>(glyphCache->getPageSize());
+            setQuadTexCoords(glyphVertices, {glyph->rect.x / pageSize, glyph->rect.y / pageSize},
+                {glyph->rect.w / pageSize, glyph->rect.h / pageSize});
+            glyphPage[index] = glyph->page;
+            atlasGlyphs ++;
+        } else {
+            setQuadTexCoords(glyphVertices, glyphTexCoords['?'], tileTexSize);
+        }
+    }
+
+    /**
+     * @brief renders the cells referenced by an index stream
+     * 
+     * @param cells the buffer being presented
+     * @param cellIndices index stream built like indices, background
+     * quads first
+     */
+    void renderCells(const CellBuffer& cells, const std::vector<int>& cellIndices) {
+        if (renderBackend == RenderBackend::Geometry && !renderGeometry(cells, cellIndices)) {
+            std::cerr << "SDL_RenderGeometry is not available, falling back to the texture backend: " << SDL_GetError() << std::endl;
+            renderBackend = RenderBackend::Texture;
+        }
+        if (renderBackend == RenderBackend::Texture) {
+            int numCells = cells.size();
+            for (size_t i = 0; i < cellIndices.size(); i += 6) {
+                int quad = cellIndices[i] / 4;
+                if (quad < numCells) {
+                    renderTextureCell(cells, quad);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief renders the cells referenced by an index stream with a
+     * single SDL_RenderGeometry call, or one call per texture when some
+     * glyphs come from the atlas
+     * 
+     * @param cells the buffer being presented
+     * @param cellIndices index stream built like indices, background
+     * quads first
+     * @return true 
+     * @return false if the renderer does not support geometry
+     */
+    bool renderGeometry(const CellBuffer& cells, const std::vector<int>& cellIndices) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        int numCells = cells.size();
+        atlasGlyphs = 0;
+        for (size_t i = 0; i < cellIndices.size(); i += 6) {
+            int quad = cellIndices[i] / 4;
+            if (quad < numCells) {
+                updateCellVertices(cells, quad);
+            }
+        }
+        if (atlasGlyphs == 0) {
+            return SDL_RenderGeometry(renderer, tileset, vertices.data(), static_cast<int>(vertices.size()), cellIndices.data(), static_cast<int>(cellIndices.size())) == 0;
+        }
+
+        // backgrounds and tileset glyphs first, then the glyphs of each page
+        tilesetIndices.clear();
+        pageIndices.resize(glyphCache->getPageCount());
+        for (auto& page : pageIndices) {
+            page.clear();
+        }
+        for (size_t i = 0; i < cellIndices.size(); i += 6) {
+            int quad = cellIndices[i] / 4;
+            std::vector<int>& stream = quad < numCells || glyphPage[quad - numCells] < 0 ? tilesetIndices : pageIndices[glyphPage[quad - numCells]];
+            stream.insert(stream.end(), cellIndices.begin() + i, cellIndices.begin() + i + 6);
+        }
+        if (SDL_RenderGeometry(renderer, tileset, vertices.data(), static_cast<int>(vertices.size()), tilesetIndices.data(), static_cast<int>(tilesetIndices.size())) != 0) {
+            return false;
+        }
+        for (size_t page = 0; page < pageIndices.size(); page ++) {
+            if (!pageIndices[page].empty()) {
+                SDL_RenderGeometry(renderer, glyphCache->getPage(page), vertices.data(), static_cast<int>(vertices.size()),
+                    pageIndices[page].data(), static_cast<int>(pageIndices[page].size()));
+            }
+        }
+        return true;
+#else
+        SDL_SetError("SDL %d.%d.%d is older than 2.0.18", SDL_MAJOR_VERSION, SDL_MINOR_VERSION, SDL_PATCHLEVEL);
+        return false;
+#endif
+    }
+
+    /**
+     * @brief renders a cell with two SDL_RenderCopyEx calls
+     * 
+     * @param cells the buffer being presented
+     * @param index the plane index of the cell
+     */
+    void renderTextureCell(const CellBuffer& cells, int index) {
+        Uint32 ch = cells.chs()[index];
+        SDL_Color backColor = cells.backColors()[index];
+        SDL_Color foreColor = cells.foreColors()[index];
+        SDL_Rect backSrcRect = {(219 % numSrcCols) * tileWidth, (219 / numSrcCols) * tileHeight, tileWidth, tileHeight};
+        SDL_Rect destRect = {(index % cellCols) * cellWidth, (index / cellCols) * cellHeight, cellWidth, cellHeight};
+        SDL_SetTextureColorMod(tileset, backColor.r, backColor.g, backColor.b);
+        SDL_SetTextureAlphaMod(tileset, backColor.a);
+        SDL_RenderCopyEx(renderer, tileset, &backSrcRect, &destRect, 0.0, nullptr, SDL_FLIP_NONE);
+        SDL_Texture* texture = tileset;
+        SDL_Rect srcRect;
+        const GlyphCache::Glyph* glyph = nullptr;
+        if (ch >= static_cast<Uint32>(numSrcRows * numSrcCols)) {
+            glyph = findAtlasGlyph(ch);
+            ch = '?';
+        }
+        if (glyph) {
+            texture = glyphCache->getPage(glyph->page);
+            srcRect = glyph->rect;
+        } else {
+            srcRect = {static_cast<int>(ch % numSrcCols) * tileWidth, static_cast<int>(ch / numSrcCols) * tileHeight, tileWidth, tileHeight};
+        }
+        SDL_SetTextureColorMod(texture, foreColor.r, foreColor.g, foreColor.b);
+        SDL_SetTextureAlphaMod(texture, foreColor.a);
+        SDL_RenderCopyEx(renderer, texture, &srcRect, &destRect, 0.0, nullptr, SDL_FLIP_NONE);
+    }
+
+    /**
+     * @brief compares two colors
+     * 
+     * @param color1 (r, g, b, a)
+     * @param color2 (r, g, b, a)
+     * @return true if every channel is equal
+     */
+    static inline bool equalColor(SDL_Color color1, SDL_Color color2) {
+        return color1.r == color2.r && color1.g == color2.g && color1.b == color2.b && color1.a == color2.a;
+    }
+
+    /**
+     * @brief redraws the cells that differ from prevBuffer into the
+     * current render target. Each row of dirty cells is split into runs,
+     * and runs with the same columns in consecutive rows are merged into
+     * one rectangle that is cleared before the cells are drawn again.
+     * 
+     * @param cells the buffer being presented
+     */
+    void renderDirtyCells(const CellBuffer& cells) {
+        const Uint32* chs = cells.chs();
+        const SDL_Color* foreColors = cells.foreColors();
+        const SDL_Color* backColors = cells.backColors();
+        Uint32* prevChs = prevBuffer.chs();
+        SDL_Color* prevForeColors = prevBuffer.foreColors();
+        SDL_Color* prevBackColors = prevBuffer.backColors();
+        int numCells = cells.size();
 
-        loop = false;
+        dirtyCells = 0;
+        dirtyIndices.clear();
+        dirtyRects.clear();
+        openRects.clear();
+        for (int i = 0; i < cellRows; i ++) {
+            nextOpenRects.clear();
+            size_t open = 0;
+            int j = 0;
+            while (j < cellCols) {
+                int index = cells.index(j, i);
+                if (frameValid && chs[index] == prevChs[index]
+                    && equalColor(foreColors[index], prevForeColors[index])
+                    && equalColor(backColors[index], prevBackColors[index])) {
+                    j ++;
+                    continue;
+                }
 
-        int tileWidth = 0;
-        int tileHeight = 0;
+                // extend the run of dirty cells
+                int runStart = j;
+                for (; j < cellCols; j ++) {
+                    index = cells.index(j, i);
+                    if (frameValid && chs[index] == prevChs[index]
+                        && equalColor(foreColors[index], prevForeColors[index])
+                        && equalColor(backColors[index], prevBackColors[index])) {
+                        break;
+                    }
+                    prevChs[index] = chs[index];
+                    prevForeColors[index] = foreColors[index];
+                    prevBackColors[index] = backColors[index];
+                    dirtyIndices.insert(dirtyIndices.end(), &indices[index * 6], &indices[index * 6 + 6]);
+                    dirtyCells ++;
+                }
 
-        if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS | SDL_INIT_AUDIO) < 0) {
-            std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
-            return false;
-        } else {
-            window = SDL_CreateWindow(windowTitle.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, screenWidth, screenHeight, SDL_WINDOW_SHOWN);
-            SDL_SetWindowFullscreen(window, 0);
-            SDL_RaiseWindow(window);
-            if (!window) {
-                std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
-                return false;
-            } else {
-                renderer = SDL_CreateRenderer(window, -1, 0);
-                SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-                if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
-                    std::cerr << "Failed to load SDL_image: " << IMG_GetError() << std::endl;
-                    return false;
+                // grow the rect of the previous row when the columns match
+                SDL_Rect run = {runStart * cellWidth, i * cellHeight, (j - runStart) * cellWidth, cellHeight};
+                while (open < openRects.size() && dirtyRects[openRects[open]].x < run.x) {
+                    open ++;
                 }
-                if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) < 0) {
-                    std::cerr << "Failed to load SDL_mixer: " << Mix_GetError() << std::endl;
-                    return false;
+                if (open < openRects.size() && dirtyRects[openRects[open]].x == run.x && dirtyRects[openRects[open]].w == run.w) {
+                    dirtyRects[openRects[open]].h += cellHeight;
+                    nextOpenRects.push_back(openRects[open]);
+                    open ++;
+                } else {
+                    dirtyRects.push_back(run);
+                    nextOpenRects.push_back(static_cast<int>(dirtyRects.size()) - 1);
                 }
             }
+            std::swap(openRects, nextOpenRects);
         }
+        frameValid = true;
 
-        SDL_Surface* surface = IMG_Load(tilesetPath.c_str());
-        if (!surface) {
-            std::cerr << "Error initializing SDL surface: " << IMG_GetError() << std::endl;
-            return false;
-        } else {
-            SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, 255, 0, 255));
-            tileset = SDL_CreateTextureFromSurface(renderer, surface);
-            if (tileset == nullptr) {
-                std::cerr << "Error creating texture from " << tilesetPath << ": " << SDL_GetError() << std::endl;
-                return false;
-            } else {
-                tileWidth = surface->w / numSrcCols;
-                tileHeight = surface->h / numSrcRows;
+        if (dirtyCells > 0) {
+            // glyph quads follow the background quads of the same cells
+            size_t numBackIndices = dirtyIndices.size();
+            for (size_t i = 0; i < numBackIndices; i ++) {
+                dirtyIndices.push_back(dirtyIndices[i] + numCells * 4);
             }
-            SDL_FreeSurface(surface);
+            SDL_RenderFillRects(renderer, dirtyRects.data(), static_cast<int>(dirtyRects.size()));
+            renderCells(cells, dirtyIndices);
         }
+    }
 
-        buffer = std::vector<std::vector<std::shared_ptr<CellTexture>>>(cellRows);
-        for (int i = 0; i < cellRows; i ++) {
-            buffer[i] = std::vector<std::shared_ptr<CellTexture>>(cellCols);
-            for (int j = 0; j < cellCols; j ++) {
-                buffer[i][j] = std::make_shared<CellTexture>(tileset, numSrcRows, numSrcCols, tileWidth, tileHeight, cellWidth, cellHeight);
-                buffer[i][j]->setDestPosition(j * cellWidth, i * cellHeight);
+    /**
+     * @brief handles the pending SDL events, queueing the inputs. While
+     * replaying, the recorded events of the frame are handled instead
+     * and SDL events are dropped, except quitting.
+     * 
+     */
+    void pollEvents() {
+        while (SDL_PollEvent(&event)) {
+            if (!inputLog.isReplaying()) {
+                handleEvent(event);
+            } else if (event.type == SDL_QUIT) {
+                loop = false;
             }
         }
-        return true;
+        for (const SDL_Event& replayed : replayEvents) {
+            handleEvent(replayed);
+        }
     }
 
     /**
-     * @brief blends two colors
+     * @brief handles an event, recording it if recording
      * 
-     * @param color1 (r, g, b, a)
-     * @param color2 (r, g, b, a)
-     * @return SDL_Color 
+     * @param event 
      */
-    SDL_Color blendColor(SDL_Color color1, SDL_Color color2) {
-        double red = color1.r;
-        double green = color1.g;
-        double blue = color1.b;
-        double alpha = color1.a;
-        red = red * (alpha / 255.0);
-        green = green * (alpha / 255.0);
-        blue = blue * (alpha / 255.0);
-        alpha = 0.0;
-        double newRed = color2.r;
-        double newGreen = color2.g;
-        double newBlue = color2.b;
-        double newAlpha = color2.a;
-        red = newRed * (newAlpha / 255.0) + red * (1.0 - newAlpha / 255.0);
-        green = newGreen * (newAlpha / 255.0) + green * (1.0 - newAlpha / 255.0);
-        blue = newBlue * (newAlpha / 255.0) + blue * (1.0 - newAlpha / 255.0);
-        alpha = 255.0;
-        SDL_Color blended = {0, 0, 0, 0};
-        blended.r = static_cast<Uint8>(round(red));
-        blended.g = static_cast<Uint8>(round(green));
-        blended.b = static_cast<Uint8>(round(blue));
-        blended.a = static_cast<Uint8>(round(alpha));
-        return blended;
+    void handleEvent(const SDL_Event& event) {
+        if (inputLog.isRecording()) {
+            inputLog.recordEvent(event);
+        }
+        switch (event.type) {
+            case SDL_QUIT: {
+                loop = false;
+                break;
+            }
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET: {
+                frameValid = false;
+                break;
+            }
+            case SDL_KEYDOWN:
+            case SDL_KEYUP: {
+                InputEvent input = {event.type == SDL_KEYDOWN ? InputEvent::Type::KeyDown : InputEvent::Type::KeyUp,
+                    event.key.timestamp, event.key.keysym.scancode, event.key.keysym.sym, event.key.repeat != 0, -1, cursorPosX, cursorPosY};
+                inputEvents.push_back(input);
+                break;
+            }
+            case SDL_MOUSEMOTION: {
+                cursorPosX = event.motion.x / cellWidth;
+                cursorPosY = event.motion.y / cellHeight;
+                // a fast mouse sends many moves per frame, only the last of a run is kept
+                if (inputEvents.size() > appliedEvents && inputEvents.back().type == InputEvent::Type::CursorMove) {
+                    inputEvents.back().timestamp = event.motion.timestamp;
+                    inputEvents.back().x = cursorPosX;
+                    inputEvents.back().y = cursorPosY;
+                } else {
+                    InputEvent input = {InputEvent::Type::CursorMove, event.motion.timestamp, SDL_SCANCODE_UNKNOWN, 0, false, -1, cursorPosX, cursorPosY};
+                    inputEvents.push_back(input);
+                }
+                break;
+            }
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP: {
+                int button = cursorIndexOf(event.button.button);
+                if (button >= 0) {
+                    InputEvent input = {event.type == SDL_MOUSEBUTTONDOWN ? InputEvent::Type::ButtonDown : InputEvent::Type::ButtonUp,
+                        event.button.timestamp, SDL_SCANCODE_UNKNOWN, 0, false, button, event.button.x / cellWidth, event.button.y / cellHeight};
+                    inputEvents.push_back(input);
+                }
+                break;
+            }
+        }
     }
 
     /**
-     * @brief draws a charactor ch at (x, y) width foreColor and backColor
+     * @brief Get the cursor index of an SDL mouse button
      * 
-     * @param x x-coordinate (the index of column)
-     * @param y y-coordinate (the index of row)
-     * @param ch charactor
-     * @param foreColor (r, g, b, a)
-     * @param backColor (r, g, b, a)
+     * @param button 
+     * @return int the index, -1 for buttons that are not tracked
      */
-    void draw(int x, int y, Uint8 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
-        if (0 <= x && x < cellCols && 0 <= y && y < cellRows) {
-            buffer[y][x]->setCh(ch);
-            buffer[y][x]->setForeColor(blendColor(buffer[y][x]->getForeColor(), foreColor));
-            buffer[y][x]->setBackColor(blendColor(buffer[y][x]->getBackColor(), backColor));
+    static int cursorIndexOf(Uint8 button) {
+        switch (button) {
+            case SDL_BUTTON_LEFT: {
+                return 0;
+            }
+            case SDL_BUTTON_RIGHT: {
+                return 1;
+            }
+            case SDL_BUTTON_MIDDLE: {
+                return 2;
+            }
+            case SDL_BUTTON_X1: {
+                return 3;
+            }
+            case SDL_BUTTON_X2: {
+                return 4;
+            }
         }
+        return -1;
     }
 
     /**
-     * @brief draws a line from (x1, y1) to (x2, y2)
+     * @brief applies the inputs queued since the last frame to the key
+     * and cursor states, so only the keys that changed are touched
      * 
-     * @param x1 
-     * @param y1 
-     * @param x2 
-     * @param y2 
-     * @param ch 
-     * @param foreColor 
-     * @param backColor 
      */
-    void drawLine(int x1, int y1, int x2, int y2, Uint8 ch = ' ', SDL_Color foreColor = {255, 255, 255, 255}, SDL_Color backColor = {0, 0, 0, 255}) {
-        if (0 <= x1 && x1 < cellCols && 0 <= y1 && y1 < cellRows
-            && 0 <= x2 && x2 < cellCols && 0 <= y2 && y2 < cellRows) {
-            int dx = abs(x2 - x1);
-            int dy = -abs(y2 - y1);
-
-            // straight line optimization
-            if (dx == 0) {  // vertical
-                if (y1 > y2) {
-                    std::swap(y1, y2);
+    void updateInputState() {
+        for (size_t i = appliedEvents; i < inputEvents.size(); i ++) {
+            const InputEvent& input = inputEvents[i];
+            switch (input.type) {
+                case InputEvent::Type::KeyDown: {
+                    if (input.scancode < TOTAL_KEYS && !keyHold[input.scancode]) {
+                        keyPressed[input.scancode] = true;
+                        keyHold[input.scancode] = true;
+                    }
+                    break;
                 }
-                for (int y = y1; y <= y2; y ++) {
-                    draw(x1, y, ch, foreColor, backColor);
+                case InputEvent::Type::KeyUp: {
+                    if (input.scancode < TOTAL_KEYS && keyHold[input.scancode]) {
+                        keyReleased[input.scancode] = true;
+                        keyHold[input.scancode] = false;
+                    }
+                    break;
                 }
-            } else if (dy == 0) {   // horizontal
-                if (x1 > x2) {
-                    std::swap(x1, x2);
+                case InputEvent::Type::ButtonDown: {
+                    cursorPressed[input.button] = true;
+                    cursorHold[input.button] = true;
+                    break;
                 }
-                for (int x = x1; x <= x2; x ++) {
-                    draw(x, y1, ch, foreColor, backColor);
+                case InputEvent::Type::ButtonUp: {
+                    cursorReleased[input.button] = true;
+                    cursorHold[input.button] = false;
+                    break;
                 }
-            } else {
-                int sx = x1 < x2 ? 1 : -1;
-                int sy = y1 < y2 ? 1 : -1;
-                int error = dx + dy;
-                while (1) {                    
-                    draw(x1, y1, ch, foreColor, backColor);
-                    if (x1 == x2 && y1 == y2) {
-                        break;
-                    }
-                    int error2 = 2 * error;
-                    if (error2 >= dy) {
-                        error += dy;
-                        x1 += sx;
-                    }
-                    if (error2 <= dx) {
-                        error += dx;
-                        y1 += sy;
-                    }
+                case InputEvent::Type::CursorMove: {
+                    break;
                 }
             }
         }
+        appliedEvents = inputEvents.size();
     }
 
     /**
-     * @brief Get the character at (x, y)
+     * @brief clears the console cells to the layers under the console,
+     * recompositing them only if one of them changed
      * 
-     * @param x x-coordinate (the index of column)
-     * @param y y-coordinate (the index of row)
-     * @return Uint8 
      */
-    Uint8 getCh(int x, int y) const {
-        if (0 <= x && x < cellCols && 0 <= y && y < cellRows) {
-            return buffer[y][x]->getCh();
-        } else {
-            return 0;
+    void clearCells() {
+        setDrawTarget(CONSOLE_LAYER);
+        sortLayers();
+        bool anyBelow = false;
+        for (size_t i = 0; i < layers.size(); i ++) {
+            if (layers[i] && (layers[i]->z < 0 || layerBelow[i])) {
+                anyBelow = true;
+                if (layers[i]->dirty) {
+                    baseValid = false;
+                }
+            }
+        }
+        if (!anyBelow) {
+            buffer.clear(' ', {255, 255, 255, 255}, {0, 0, 0, 255});
+            return;
+        }
+        if (!baseValid) {
+            baseCells.clear(' ', {255, 255, 255, 255}, {0, 0, 0, 255});
+            for (size_t i = 0; i < layers.size(); i ++) {
+                layerBelow[i] = layers[i] && layers[i]->z < 0;
+            }
+            for (CellLayer* layer : layerOrder) {
+                if (layer->z < 0) {
+                    composeLayer(baseCells, *layer);
+                }
+            }
+            baseValid = true;
         }
+        buffer = baseCells;
     }
 
     /**
-     * @brief Get the Fore Color at (x, y)
+     * @brief composites the layers over the console onto the console
+     * cells
      * 
-     * @param x x-coordinate (the index of column)
-     * @param y y-coordinate (the index of row)
-     * @return SDL_Color 
      */
-    SDL_Color getForeColor(int x, int y) const {
-        if (0 <= x && x < cellCols && 0 <= y && y < cellRows) {
-            return buffer[y][x]->getForeColor();
-        } else {
-            return {0, 0, 0, 0};
+    void composeLayersAbove() {
+        setDrawTarget(CONSOLE_LAYER);
+        sortLayers();
+        for (size_t i = 0; i < layers.size(); i ++) {
+            if (layers[i] && layers[i]->z >= 0 && layerBelow[i]) {
+                // moved over the console, baseCells still holds it
+                baseValid = false;
+                layerBelow[i] = false;
+            }
+        }
+        for (CellLayer* layer : layerOrder) {
+            if (layer->z >= 0) {
+                composeLayer(buffer, *layer);
+            }
         }
     }
 
     /**
-     * @brief Get the Back Color at (x, y)
+     * @brief sorts the layers by z, layers of equal z keep the order
+     * they were created in
      * 
-     * @param x x-coordinate (the index of column)
-     * @param y y-coordinate (the index of row)
-     * @return SDL_Color 
      */
-    SDL_Color getBackColor(int x, int y) const {
-        if (0 <= x && x < cellCols && 0 <= y && y < cellRows) {
-            return buffer[y][x]->getBackColor();
-        } else {
-            return {0, 0, 0, 0};
+    void sortLayers() {
+        layerOrder.clear();
+        for (auto& layer : layers) {
+            if (layer) {
+                layerOrder.push_back(layer.get());
+            }
         }
+        std::stable_sort(layerOrder.begin(), layerOrder.end(), [](const CellLayer* a, const CellLayer* b) {
+            return a->z < b->z;
+        });
     }
 
     /**
-     * @brief write a string to the screen starting at (x, y)
+     * @brief blends a layer onto cells like draw does, except that the
+     * character only replaces the one below where the fore color of
+     * the layer is not transparent. Only the part of the layer that is
+     * not fully transparent is visited.
      * 
-     * @param x x-coordinate (the index of column)
-     * @param y y-coordinate (the index of row)
-     * @param content 
-     * @param foreColor (r, g, b, a)
-     * @param backColor (r, g, b, a)
+     * @param cells cells of the console size
+     * @param layer 
      */
-    void write(int x, int y, std::string content, SDL_Color foreColor = {0, 0, 0, 0}, SDL_Color backColor = {0, 0, 0, 0}) {
-        if (0 <= x && x < cellCols && 0 <= y && y < cellRows) {
-            int len = content.length();
-            for (int i = 0; i < len && x + i < cellCols; i ++) {
-                if (content[i] == ' ') continue;
-                buffer[y][x + i]->setCh(content[i]);
-                buffer[y][x + i]->setForeColor(blendColor(buffer[y][x + i]->getForeColor(), foreColor));
-                buffer[y][x + i]->setBackColor(blendColor(buffer[y][x + i]->getBackColor(), backColor));
+    void composeLayer(CellBuffer& cells, CellLayer& layer) {
+        if (layer.dirty) {
+            layer.bounds = contentBounds(layer.cells);
+            layer.dirty = false;
+        }
+        if (!layer.visible || layer.opacity == 0) {
+            return;
+        }
+        int left = std::max(layer.bounds.x + layer.offsetX, 0);
+        int top = std::max(layer.bounds.y + layer.offsetY, 0);
+        int right = std::min(layer.bounds.x + layer.bounds.w + layer.offsetX, cells.getCols());
+        int bottom = std::min(layer.bounds.y + layer.bounds.h + layer.offsetY, cells.getRows());
+        int width = right - left;
+        if (width <= 0) {
+            return;
+        }
+        for (int y = top; y < bottom; y ++) {
+            int dest = cells.index(left, y);
+            int src = layer.cells.index(left - layer.offsetX, y - layer.offsetY);
+            const Uint32* chs = layer.cells.chs() + src;
+            const SDL_Color* foreColors = layer.cells.foreColors() + src;
+            const SDL_Color* backColors = layer.cells.backColors() + src;
+            for (int x = 0; x < width; x ++) {
+                if (foreColors[x].a != 0) {
+                    cells.chs()[dest + x] = chs[x];
+                }
+            }
+            if (layer.opacity != 255) {
+                layerForeRow.resize(width);
+                layerBackRow.resize(width);
+                for (int x = 0; x < width; x ++) {
+                    layerForeRow[x] = foreColors[x];
+                    layerForeRow[x].a = div255(foreColors[x].a * layer.opacity);
+                    layerBackRow[x] = backColors[x];
+                    layerBackRow[x].a = div255(backColors[x].a * layer.opacity);
+                }
+                foreColors = layerForeRow.data();
+                backColors = layerBackRow.data();
             }
+            blendColorSpan(cells.foreColors() + dest, foreColors, width);
+            blendColorSpan(cells.backColors() + dest, backColors, width);
         }
     }
 
     /**
-     * @brief fills a rectangle region
+     * @brief Get the smallest rectangle holding every cell that is not
+     * fully transparent
      * 
-     * @param dest (x, y, w, h)
-     * @param ch character
-     * @param foreColor (r, g, b, a)
-     * @param backColor (r, g, b, a)
+     * @param cells 
+     * @return SDL_Rect empty if every cell is transparent
      */
-    void fill(SDL_Rect dest, Uint8 ch = ' ', SDL_Color foreColor = {0, 0, 0, 0}, SDL_Color backColor = {0, 0, 0, 0}) {
-        if (0 <= dest.x && dest.x < cellCols && 0 <= dest.y && dest.y < cellRows) {
-            for (int i = dest.y; i < dest.y + dest.h && i < cellRows; i ++) {
-                for (int j = dest.x; j < dest.x + dest.w && j < cellCols; j ++) {
-                    buffer[i][j]->setCh(ch);
-                    buffer[i][j]->setForeColor(blendColor(buffer[i][j]->getForeColor(), foreColor));
-                    buffer[i][j]->setBackColor(blendColor(buffer[i][j]->getBackColor(), backColor));
+    static SDL_Rect contentBounds(const CellBuffer& cells) {
+        int left = cells.getCols();
+        int top = cells.getRows();
+        int right = 0;
+        int bottom = 0;
+        for (int y = 0; y < cells.getRows(); y ++) {
+            const SDL_Color* foreColors = cells.foreColors() + cells.index(0, y);
+            const SDL_Color* backColors = cells.backColors() + cells.index(0, y);
+            for (int x = 0; x < cells.getCols(); x ++) {
+                if (foreColors[x].a != 0 || backColors[x].a != 0) {
+                    left = std::min(left, x);
+                    right = std::max(right, x + 1);
+                    top = std::min(top, y);
+                    bottom = y + 1;
                 }
             }
         }
+        if (right <= left) {
+            return {0, 0, 0, 0};
+        }
+        return {left, top, right - left, bottom - top};
     }
 
     /**
-     * @brief start the game loop
+     * @brief calls update under the profiler
      * 
+     * @param deltaTime 
+     * @return what update returned
      */
-    void init() {
-        loop = true;
-        gameLoop();
+    bool timedUpdate(double deltaTime) {
+        FrameProfiler::Scope scope(profiler, ProfilePhase::Update);
+        return update(deltaTime);
     }
 
     /**
-     * @brief clear buffer
+     * @brief calls render under the profiler, then draws the profiler
+     * overlay on top
      * 
+     * @param deltaTime 
+     * @param alpha 
+     * @return what render returned
      */
-    void clearBuffer() {
-        for (int i = 0; i < cellRows; i ++) {
-            for (int j = 0; j < cellCols; j ++) {
-                buffer[i][j]->setCh(' ');
-                buffer[i][j]->setForeColor(255, 255, 255, 255);
-                buffer[i][j]->setBackColor(0, 0, 0, 255);
+    bool timedRender(double deltaTime, double alpha) {
+        bool result;
+        {
+            FrameProfiler::Scope scope(profiler, ProfilePhase::Render);
+            result = render(deltaTime, alpha);
+            composeLayersAbove();
+        }
+        if (profilerOverlay) {
+            drawProfilerOverlay();
+        }
+        return result;
+    }
+
+    /**
+     * @brief formats the profiler statistics into overlayText, a few
+     * times per second so that they stay readable
+     * 
+     */
+    void formatProfilerOverlay() {
+        if (!profilerOverlay || frameCount % 15 != 0) {
+            return;
+        }
+        snprintf(overlayText[0], sizeof(overlayText[0]), "%-12s %6s %6s %6s", "ms", "min", "avg", "p99");
+        for (int i = 0; i < FrameProfiler::NUM_PHASES; i ++) {
+            FrameProfiler::Stats stats = profiler.getStats(static_cast<ProfilePhase>(i));
+            snprintf(overlayText[i + 1], sizeof(overlayText[i + 1]), "%-12s %6.2f %6.2f %6.2f",
+                FrameProfiler::getPhaseName(static_cast<ProfilePhase>(i)), stats.min, stats.avg, stats.p99);
+        }
+        for (int i = 0; i < FrameProfiler::NUM_COUNTERS; i ++) {
+            FrameProfiler::Stats stats = profiler.getCounterStats(static_cast<ProfileCounter>(i));
+            snprintf(overlayText[FrameProfiler::NUM_PHASES + 1 + i], sizeof(overlayText[0]), "%-12s %6.0f %6.1f %6.0f",
+                FrameProfiler::getCounterName(static_cast<ProfileCounter>(i)), stats.min, stats.avg, stats.p99);
+        }
+    }
+
+    /**
+     * @brief draws overlayText over the top-left corner of the buffer
+     * 
+     */
+    void drawProfilerOverlay() {
+        fill({0, 0, static_cast<int>(sizeof(overlayText[0])) - 1, OVERLAY_LINES}, ' ', {0, 0, 0, 0}, {0, 0, 0, 192});
+        for (int i = 0; i < OVERLAY_LINES; i ++) {
+            write(0, i, overlayText[i], {255, 255, 255, 255}, {0, 0, 0, 0});
+        }
+    }
+
+    /**
+     * @brief shows the average frame rate in the window title twice
+     * per second
+     * 
+     * @param elapsedTime seconds since the last frame
+     */
+    void updateTitle(double elapsedTime) {
+        titleTime += elapsedTime;
+        titleFrames ++;
+        if (titleTime >= 0.5) {
+            snprintf(titleText, sizeof(titleText), "%s - FPS: %.1f", windowTitle.c_str(), titleFrames / titleTime);
+            SDL_SetWindowTitle(window, titleText);
+            titleTime = 0.0;
+            titleFrames = 0;
+        }
+    }
+
+    /**
+     * @brief presents frontBuffer while pipelined
+     * 
+     */
+    void presentFront() {
+        if (renderer && renderBackend != RenderBackend::Software) {
+            SDL_RenderClear(renderer);
+        }
+        presentCells(frontBuffer);
+    }
+
+    /**
+     * @brief hands a frame to the render thread, starting it if needed
+     * 
+     * @param deltaTime passed to render
+     * @param alpha passed to render
+     */
+    void requestRender(double deltaTime, double alpha) {
+        std::unique_lock<std::mutex> lock(renderMutex);
+        if (!renderThreadRunning) {
+            // render and present may both reach getThreadPool from
+            // here on, so the pool is created before they run concurrently
+            getThreadPool();
+            renderThreadRunning = true;
+            renderThread = std::thread(&RCEngine::renderLoop, this);
+        }
+        renderDeltaTime = deltaTime;
+        renderAlpha = alpha;
+        renderRequested = true;
+        lock.unlock();
+        renderWake.notify_one();
+    }
+
+    /**
+     * @brief waits for the render thread to finish the requested frame
+     * 
+     * @return what render returned
+     */
+    bool waitRender() {
+        std::unique_lock<std::mutex> lock(renderMutex);
+        renderIdle.wait(lock, [this]() { return !renderRequested; });
+        return renderResult;
+    }
+
+    /**
+     * @brief stops the render thread after its current frame
+     * 
+     */
+    void stopRenderThread() {
+        {
+            std::lock_guard<std::mutex> lock(renderMutex);
+            if (!renderThreadRunning) {
+                return;
             }
+            renderThreadRunning = false;
         }
-        SDL_RenderClear(renderer);
+        renderWake.notify_one();
+        renderThread.join();
     }
 
     /**
-     * @brief render to the screen
+     * @brief the render thread, clears buffer and calls render for each
+     * requested frame. It makes no SDL calls.
      * 
      */
-    void renderBuffer() {
-        for (int i = 0; i < cellRows; i ++) {
-            for (int j = 0; j < cellCols; j ++) {
-                buffer[i][j]->render(renderer);
+    void renderLoop() {
+        std::unique_lock<std::mutex> lock(renderMutex);
+        while (true) {
+            renderWake.wait(lock, [this]() { return renderRequested || !renderThreadRunning; });
+            if (!renderRequested) {
+                break;
+            }
+            double deltaTime = renderDeltaTime;
+            double alpha = renderAlpha;
+            lock.unlock();
+
+            {
+                FrameProfiler::Scope scope(profiler, ProfilePhase::Clear);
+                clearCells();
             }
+            bool result = timedRender(deltaTime, alpha);
+
+            lock.lock();
+            renderResult = result;
+            renderRequested = false;
+            renderIdle.notify_one();
         }
-        SDL_RenderPresent(renderer);
     }
-private:
 
+    /**
+     * @brief resets the pressed and released edges once an update
+     * has seen them
+     * 
+     */
+    void clearInputEdges() {
+        keyPressed.reset();
+        keyReleased.reset();
+        cursorPressed.reset();
+        cursorReleased.reset();
+        inputEvents.clear();
+        appliedEvents = 0;
+    }
+
+    /**
+     * @brief sleeps until target. The OS may wake a sleeping thread
+     * late, so the thread sleeps until sleepOvershoot before target and
+     * yields for the rest; the overshoot estimate follows the observed
+     * oversleeps, rising at once and decaying slowly.
+     * 
+     * @param target 
+     */
+    void sleepUntil(std::chrono::steady_clock::time_point target) {
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            auto remaining = target - now;
+            if (remaining <= std::chrono::steady_clock::duration::zero()) {
+                break;
+            } else if (remaining > sleepOvershoot) {
+                auto request = remaining - sleepOvershoot;
+                std::this_thread::sleep_for(request);
+                auto overshoot = std::chrono::steady_clock::now() - now - request;
+                if (overshoot > sleepOvershoot) {
+                    sleepOvershoot = overshoot;
+                } else {
+                    sleepOvershoot -= (sleepOvershoot - overshoot) / 16;
+                }
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
 
     /**
      * @brief game loop
      * 
      */
     void gameLoop() {
-        if (!start()) {
+        if (!replayPath.empty()) {
+            if (!inputLog.replay(replayPath, cellWidth, cellHeight)) {
+                loop = false;
+            }
+        } else if (!recordPath.empty()) {
+            if (!inputLog.record(recordPath, cellWidth, cellHeight)) {
+                loop = false;
+            }
+        }
+        if (loop && !start()) {
             loop = false;
         }
 
-        auto time_a = std::chrono::high_resolution_clock::now();
-        auto time_b = std::chrono::high_resolution_clock::now();
+        frameCount = 0;
+        profiler.restart();
+        double accumulator = 0.0;   // simulation time not yet consumed by fixed steps
+        auto time_a = std::chrono::steady_clock::now();
+        auto time_b = std::chrono::steady_clock::now();
+        auto nextFrame = time_a;    // when the next frame may start under maxFrameRate
+        bool frontRendered = false; // whether frontBuffer holds a frame to present while pipelined
 
         while (loop) {
             while (loop) {
-                time_b = std::chrono::high_resolution_clock::now();
-                double deltaTime = std::chrono::duration_cast<std::chrono::microseconds>(time_b - time_a).count() / 1000000.0f;
+                time_b = std::chrono::steady_clock::now();
+                double elapsedTime = std::chrono::duration<double>(time_b - time_a).count();
+                double deltaTime = fixedDeltaTime > 0.0 ? fixedDeltaTime : elapsedTime;
                 time_a = time_b;
+                frameArena.reset();
+                frameHeapAllocations = rceHeapAllocations.load(std::memory_order_relaxed);
+                assets.update();
+                updateTileset();
+                if (inputLog.isReplaying()) {
+                    if (!inputLog.readFrame(deltaTime, replayEvents)) {
+                        // the recording ended
+                        loop = false;
+                        break;
+                    }
+                } else if (inputLog.isRecording()) {
+                    inputLog.beginFrame(deltaTime);
+                }
 
-                while (SDL_PollEvent(&event)) {
-                    switch (event.type) {
-                        case SDL_QUIT: {
-                            loop = false;
-                            break;
-                        }
-                        case SDL_KEYDOWN: {
-                            keyInput[event.key.keysym.sym] = true;
-                            break;
-                        }
-                        case SDL_KEYUP: {
-                            keyInput[event.key.keysym.sym] = false;
-                            break;
-                        }
-                        case SDL_MOUSEMOTION: {
-                            cursorPosX = event.motion.x / cellWidth;
-                            cursorPosY = event.motion.y / cellHeight;
-                            break;
-                        }
-                        case SDL_MOUSEBUTTONDOWN: {
-                            switch (event.button.button) {
-                                case SDL_BUTTON_LEFT: {
-                                    cursorInput[0] = true;
-                                    break;
-                                }
-                                case SDL_BUTTON_RIGHT: {
-                                    cursorInput[1] = true;
-                                    break;
-                                }
-                                case SDL_BUTTON_MIDDLE: {
-                                    cursorInput[2] = true;
-                                    break;
-                                }
-                                case SDL_BUTTON_X1: {
-                                    cursorInput[3] = true;
-                                    break;
-                                }
-                                case SDL_BUTTON_X2: {
-                                    cursorInput[4] = true;
-                                    break;
-                                }
-                            }
+                if (profilerOverlay) {
+                    profiler.enabled = true;
+                }
+                {
+                    FrameProfiler::Scope scope(profiler, ProfilePhase::Events);
+                    pollEvents();
+                }
+                {
+                    FrameProfiler::Scope scope(profiler, ProfilePhase::Input);
+                    updateInputState();
+                }
+
+                // pressed and released stay set until an update has seen them
+                double alpha = 1.0;
+                if (updateRate > 0.0) {
+                    double step = 1.0 / updateRate;
+                    accumulator += deltaTime;
+                    for (int updates = 0; accumulator >= step && loop; updates ++) {
+                        if (updates == maxUpdatesPerFrame) {
+                            accumulator = std::fmod(accumulator, step);
                             break;
                         }
-                        case SDL_MOUSEBUTTONUP: {
-                            switch (event.button.button) {
-                                case SDL_BUTTON_LEFT: {
-                                    cursorInput[0] = false;
-                                    break;
-                                }
-                                case SDL_BUTTON_RIGHT: {
-                                    cursorInput[1] = false;
-                                    break;
-                                }
-                                case SDL_BUTTON_MIDDLE: {
-                                    cursorInput[2] = false;
-                                    break;
-                                }
-                                case SDL_BUTTON_X1: {
-                                    cursorInput[3] = false;
-                                    break;
-                                }
-                                case SDL_BUTTON_X2: {
-                                    cursorInput[4] = false;
-                                    break;
-                                }
-                            }
-                            break;
+                        if (!timedUpdate(step)) {
+                            loop = false;
                         }
+                        clearInputEdges();
+                        accumulator -= step;
                     }
+                    alpha = accumulator / step;
+                } else {
+                    if (!timedUpdate(deltaTime)) {
+                        loop = false;
+                    }
+                    clearInputEdges();
                 }
-                
-                for (int i = 0; i < TOTAL_KEYS; i ++) {
-                    keyState[i].pressed = false;
-                    keyState[i].released = false;
-                    if (keyInput[i] != prevKeyInput[i]) {
-                        if (keyInput[i]) {
-                            keyState[i].pressed = !keyState[i].hold;
-                            keyState[i].hold = true;
-                        } else {
-                            keyState[i].released = true;
-                            keyState[i].hold = false;
-                        }
+
+                if (pipelined) {
+                    // render this frame while the previous one is presented
+                    requestRender(deltaTime, alpha);
+                    if (frontRendered) {
+                        presentFront();
                     }
-                    prevKeyInput[i] = keyInput[i];
-                }
-
-                for (int i = 0; i < TOTAL_CURSOR_STATES; i ++) {
-                    cursorState[i].pressed = false;
-                    cursorState[i].released = false;
-                    if (cursorInput[i] != prevCursorInput[i]) {
-                        if (cursorInput[i]) {
-                            cursorState[i].pressed = true;
-                            cursorState[i].hold = true;
-                        } else {
-                            cursorState[i].released = true;
-                            cursorState[i].hold = false;
-                        }
+                    if (!waitRender()) {
+                        loop = false;
                     }
-                    prevCursorInput[i] = cursorInput[i];
+                    std::swap(buffer, frontBuffer);
+                    handOverCapture();
+                    frontRendered = true;
+                } else {
+                    clearBuffer();
+                    if (!timedRender(deltaTime, alpha)) {
+                        loop = false;
+                    }
+                    renderBuffer();
                 }
 
-                if (!update(deltaTime)) {
+                frameCount ++;
+                if (frameLimit > 0 && frameCount >= frameLimit) {
                     loop = false;
                 }
 
-                clearBuffer();
-                if (!render(deltaTime)) {
-                    loop = false;
+                if (window) {
+                    updateTitle(elapsedTime);
+                }
+
+                if (maxFrameRate > 0.0 && loop && !inputLog.isReplaying()) {
+                    auto frameDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / maxFrameRate));
+                    nextFrame += frameDuration;
+                    auto now = std::chrono::steady_clock::now();
+                    if (nextFrame < now - frameDuration) {
+                        // too far behind to catch up, pace from now on
+                        nextFrame = now;
+                    }
+                    sleepUntil(nextFrame);
                 }
-                renderBuffer();
 
-                std::string title = windowTitle + " - FPS: " + std::to_string(1.0f / deltaTime);
-                SDL_SetWindowTitle(window, title.c_str());
+                profiler.setCounter(ProfileCounter::HeapAllocations, static_cast<double>(rceHeapAllocations.load(std::memory_order_relaxed) - frameHeapAllocations));
+                profiler.setCounter(ProfileCounter::ArenaAllocations, static_cast<double>(frameArena.getAllocationCount()));
+                profiler.setCounter(ProfileCounter::ArenaBytes, static_cast<double>(frameArena.getBytesUsed()));
+                profiler.endFrame();
+                formatProfilerOverlay();
             }
 
+            if (frontRendered) {
+                // the last frame rendered while pipelined
+                presentFront();
+                frontRendered = false;
+            }
+            stopRenderThread();
             if (destroy()) {
-                if (!tileset) {
-                    SDL_DestroyTexture(tileset);
-                    tileset = nullptr;
+                frameWriter.stop();
+                inputLog.close();
+                replayEvents.clear();
+                glyphCache.reset();
+                if (font) {
+                    TTF_CloseFont(font);
+                    font = nullptr;
+                    TTF_Quit();
+                }
+                assets.clear();
+                tileset = nullptr;
+                tilesetAsset = -1;
+                pendingTileset = -1;
+                if (frameTexture) {
+                    SDL_DestroyTexture(frameTexture);
+                    frameTexture = nullptr;
+                }
+                if (renderer) {
+                    SDL_DestroyRenderer(renderer);
+                    renderer = nullptr;
+                }
+                if (frameSurface) {
+                    SDL_FreeSurface(frameSurface);
+                    frameSurface = nullptr;
+                }
+                if (window) {
+                    Mix_CloseAudio();
+                    SDL_DestroyWindow(window);
+                    window = nullptr;
                 }
-                SDL_DestroyWindow(window);
-                SDL_DestroyRenderer(renderer);
                 Mix_Quit();
                 IMG_Quit();
                 SDL_Quit();
@@ -794,6 +7216,8 @@ private:
                 loop = true;
             }
         }
+        // also when start or the input log failed and no frame ran
+        restoreTerminal();
     }
 
 public:
@@ -824,6 +7248,20 @@ public:
      */
     virtual bool render(double deltaTime) = 0;
 
+    /**
+     * @brief called every frame after update and renders
+     * things to the buffer, calls render(deltaTime) unless overridden
+     * 
+     * @param deltaTime elapse time between frames
+     * @param alpha how far the simulation is between the last fixed
+     * update and the next one in [0, 1), always 1 without updateRate
+     * @return true 
+     * @return false 
+     */
+    virtual bool render(double deltaTime, [[maybe_unused]] double alpha) {
+        return render(deltaTime);
+    }
+
     /**
      * @brief called when the game loop stops
      * 
@@ -857,21 +7295,49 @@ public:
     /**
      * @brief Get the Key State of key
      * 
-     * @param key 
+     * @param key an SDL keycode such as SDLK_a or SDLK_UP
      * @return KeyState 
      */
     KeyState getKeyState(int key) const {
-        return keyState[key];
+        return getScancodeState(SDL_GetScancodeFromKey(key));
+    }
+
+    /**
+     * @brief Get the Key State of a physical key, which does not
+     * depend on the keyboard layout
+     * 
+     * @param scancode an SDL scancode such as SDL_SCANCODE_W
+     * @return KeyState 
+     */
+    KeyState getScancodeState(SDL_Scancode scancode) const {
+        if (scancode <= SDL_SCANCODE_UNKNOWN || scancode >= TOTAL_KEYS) {
+            return {false, false, false};
+        }
+        return {keyPressed[scancode], keyReleased[scancode], keyHold[scancode]};
     }
 
     /**
      * @brief Get the Cursor State of cursor
      * 
-     * @param cursor 
+     * @param cursor 0 to 4 for the left, right, middle, X1 and X2 buttons
      * @return KeyState 
      */
     KeyState getCursorState(int cursor) const {
-        return cursorState[cursor];
+        if (cursor < 0 || cursor >= TOTAL_CURSOR_STATES) {
+            return {false, false, false};
+        }
+        return {cursorPressed[cursor], cursorReleased[cursor], cursorHold[cursor]};
+    }
+
+    /**
+     * @brief Get the inputs received since the last update, oldest
+     * first. Unlike the key states, a key pressed and released within
+     * one frame shows up as both events.
+     * 
+     * @return const std::vector<InputEvent>& 
+     */
+    const std::vector<InputEvent>& getInputEvents() const {
+        return inputEvents;
     }
 
 protected:
@@ -0,0 +1,138 @@
+/**
+ * @file blend.cpp
+ * @brief microbenchmark of RCEngine::blendColor and its span variants
+ * against the original double precision implementation
+ *
+ * g++ -O2 [-mavx2] blend.cpp -o blend -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+ */
+#include "../RCEngine.hpp"
+
+#include <cstdio>
+#include <random>
+
+/**
+ * @brief the double precision blendColor the engine used before the
+ * fixed point version
+ *
+ */
+static SDL_Color blendColorDouble(SDL_Color color1, SDL_Color color2) {
+    double red = color1.r;
+    double green = color1.g;
+    double blue = color1.b;
+    double alpha = color1.a;
+    red = red * (alpha / 255.0);
+    green = green * (alpha / 255.0);
+    blue = blue * (alpha / 255.0);
+    double newRed = color2.r;
+    double newGreen = color2.g;
+    double newBlue = color2.b;
+    double newAlpha = color2.a;
+    red = newRed * (newAlpha / 255.0) + red * (1.0 - newAlpha / 255.0);
+    green = newGreen * (newAlpha / 255.0) + green * (1.0 - newAlpha / 255.0);
+    blue = newBlue * (newAlpha / 255.0) + blue * (1.0 - newAlpha / 255.0);
+    SDL_Color blended = {0, 0, 0, 255};
+    blended.r = static_cast<Uint8>(round(red));
+    blended.g = static_cast<Uint8>(round(green));
+    blended.b = static_cast<Uint8>(round(blue));
+    return blended;
+}
+
+/**
+ * @brief the exact result blendColor rounds, which differs from the
+ * original only over translucent colors
+ *
+ */
+static SDL_Color blendColorReference(SDL_Color color1, SDL_Color color2) {
+    if (color1.a == 255) {
+        return blendColorDouble(color1, color2);
+    }
+    // weights scaled by 255 * 255 keep the quotients exact at ties
+    double weight1 = color1.a * (255.0 - color2.a);
+    double weight2 = color2.a * 255.0;
+    double total = weight1 + weight2;
+    if (total == 0.0) {
+        return color1;
+    }
+    return {static_cast<Uint8>(round((color2.r * weight2 + color1.r * weight1) / total)),
+            static_cast<Uint8>(round((color2.g * weight2 + color1.g * weight1) / total)),
+            static_cast<Uint8>(round((color2.b * weight2 + color1.b * weight1) / total)),
+            static_cast<Uint8>(round(total / 255.0))};
+}
+
+static bool equalColor(SDL_Color color1, SDL_Color color2) {
+    return color1.r == color2.r && color1.g == color2.g && color1.b == color2.b && color1.a == color2.a;
+}
+
+template <typename F>
+static double measure(F&& f, int repeats) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i ++) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / repeats;
+}
+
+int main() {
+    const int count = 320 * 180;
+    const int repeats = 200;
+    std::mt19937 random(42);
+    std::vector<SDL_Color> base(count);
+    std::vector<SDL_Color> colors(count);
+    for (int i = 0; i < count; i ++) {
+        base[i] = {static_cast<Uint8>(random()), static_cast<Uint8>(random()), static_cast<Uint8>(random()), 255};
+        colors[i] = {static_cast<Uint8>(random()), static_cast<Uint8>(random()), static_cast<Uint8>(random()), static_cast<Uint8>(random())};
+    }
+    // a few translucent cells take the general path
+    for (int i = 0; i < count; i += 97) {
+        base[i].a = static_cast<Uint8>(random());
+    }
+    SDL_Color color = {200, 100, 50, 150};
+
+    // correctness
+    std::vector<SDL_Color> spanConst = base;
+    std::vector<SDL_Color> spanColors = base;
+    RCEngine::blendColorSpan(spanConst.data(), color, count);
+    RCEngine::blendColorSpan(spanColors.data(), colors.data(), count);
+    int mismatches = 0;
+    for (int i = 0; i < count; i ++) {
+        mismatches += !equalColor(blendColorReference(base[i], colors[i]), RCEngine::blendColor(base[i], colors[i]));
+        mismatches += !equalColor(blendColorReference(base[i], color), spanConst[i]);
+        mismatches += !equalColor(blendColorReference(base[i], colors[i]), spanColors[i]);
+    }
+
+    std::vector<SDL_Color> dest = base;
+    double doubleTime = measure([&]() {
+        for (int i = 0; i < count; i ++) {
+            dest[i] = blendColorDouble(dest[i], colors[i]);
+        }
+    }, repeats);
+    dest = base;
+    double scalarTime = measure([&]() {
+        for (int i = 0; i < count; i ++) {
+            dest[i] = RCEngine::blendColor(dest[i], colors[i]);
+        }
+    }, repeats);
+    dest = base;
+    double spanTime = measure([&]() {
+        RCEngine::blendColorSpan(dest.data(), colors.data(), count);
+    }, repeats);
+    dest = base;
+    double spanConstTime = measure([&]() {
+        RCEngine::blendColorSpan(dest.data(), color, count);
+    }, repeats);
+
+#if defined(RCE_AVX2)
+    const char* simd = "avx2";
+#elif defined(RCE_SSE2)
+    const char* simd = "sse2";
+#else
+    const char* simd = "scalar";
+#endif
+    printf("simd=%s cells=%d mismatches=%d\n", simd, count, mismatches);
+    printf("%-24s %10.3f ns/cell\n", "blendColorDouble", doubleTime / count);
+    printf("%-24s %10.3f ns/cell\n", "blendColor", scalarTime / count);
+    printf("%-24s %10.3f ns/cell\n", "blendColorSpan(colors)", spanTime / count);
+    printf("%-24s %10.3f ns/cell\n", "blendColorSpan(color)", spanConstTime / count);
+    return mismatches == 0 ? 0 : 1;
+}
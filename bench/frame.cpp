@@ -0,0 +1,262 @@
+/**
+ * @file frame.cpp
+ * @brief benchmarks of the drawing calls and of whole frames rendered
+ * offscreen, for several grid sizes and render configurations
+ *
+ * g++ -O2 frame.cpp -o frame -pthread -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+ * ./frame [frames]     (default: 300, run from the directory of RCE_tileset.png)
+ *
+ * Prints one CSV line per result: benchmark,grid,config,stat,us
+ * (frame_heapAllocs reports heap allocations per frame instead of us)
+ * Microbenchmarks report the median of 5 samples, whole frames report the
+ * statistics of the frame profiler over the last frames of the run.
+ */
+#define RCE_TRACK_ALLOCATIONS
+#include "../RCEngine.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * @brief runs f in samples long enough to time, and returns the median
+ * time of one call in microseconds
+ *
+ */
+template <typename F>
+static double measure(F&& f) {
+    using clock = std::chrono::steady_clock;
+    const int samples = 5;
+    const double minSampleTime = 5000.0;
+    f();
+    int repeats = 1;
+    while (true) {
+        auto start = clock::now();
+        for (int i = 0; i < repeats; i ++) {
+            f();
+        }
+        double time = std::chrono::duration<double, std::micro>(clock::now() - start).count();
+        if (time >= minSampleTime || repeats >= (1 << 20)) {
+            break;
+        }
+        repeats *= 2;
+    }
+    double times[samples];
+    for (int s = 0; s < samples; s ++) {
+        auto start = clock::now();
+        for (int i = 0; i < repeats; i ++) {
+            f();
+        }
+        times[s] = std::chrono::duration<double, std::micro>(clock::now() - start).count() / repeats;
+    }
+    std::sort(times, times + samples);
+    return times[samples / 2];
+}
+
+static void report(const char* benchmark, const char* grid, const char* config, const char* stat, double us) {
+    printf("%s,%s,%s,%s,%.3f\n", benchmark, grid, config, stat, us);
+}
+
+class FrameBench : public RCEngine {
+    const char* grid;
+    const char* config;
+    bool micro;
+    double t;
+
+public:
+    FrameBench(const char* grid, const char* config, RenderBackend backend, bool retained, bool micro, int frames) {
+        displayMode = DisplayMode::Offscreen;
+        renderBackend = backend;
+        retainedMode = retained;
+        fixedDeltaTime = 1.0 / 60.0;
+        frameLimit = frames;
+        profiler.enabled = true;
+        this->grid = grid;
+        this->config = config;
+        this->micro = micro;
+        t = 0.0;
+    }
+
+    bool start() override {
+        if (micro) {
+            runDrawBenchmarks();
+        }
+        scene();
+        report("renderBuffer_static", grid, config, "median", measure([this]() { renderBuffer(); }));
+        return true;
+    }
+
+    bool update(double deltaTime) override {
+        t += deltaTime * 120.0;
+        if (t > 500.0) {
+            t = 0.0;
+        }
+        return true;
+    }
+
+    bool render(double) override {
+        scene();
+        return true;
+    }
+
+    bool destroy() override {
+        const ProfilePhase phases[] = {ProfilePhase::Clear, ProfilePhase::Render, ProfilePhase::RenderBuffer, ProfilePhase::Frame};
+        for (ProfilePhase phase : phases) {
+            FrameProfiler::Stats stats = getProfiler().getStats(phase);
+            char benchmark[32];
+            snprintf(benchmark, sizeof(benchmark), "frame_%s", FrameProfiler::getPhaseName(phase));
+            report(benchmark, grid, config, "avg", stats.avg * 1000.0);
+            report(benchmark, grid, config, "p99", stats.p99 * 1000.0);
+        }
+        // counts per frame, not microseconds
+        FrameProfiler::Stats allocations = getProfiler().getCounterStats(ProfileCounter::HeapAllocations);
+        report("frame_heapAllocs", grid, config, "avg", allocations.avg);
+        report("frame_heapAllocs", grid, config, "p99", allocations.p99);
+        return true;
+    }
+
+private:
+    Uint8 channel(int n, int offset) const {
+        n += t;
+        int x = (static_cast<int>(round(t)) + n + offset) % 500;
+        return static_cast<Uint8>(abs(255 - x));
+    }
+
+    /**
+     * @brief the scene of the demo, scaled to the grid
+     *
+     */
+    void scene() {
+        clearBuffer();
+        for (int y = 0; y < cellRows; y ++) {
+            for (int x = 0; x < cellCols; x ++) {
+                draw(x, y, ' ', {255, 255, 255, 255},
+                    {channel(x * (cellRows - y), 255), channel(y * (cellCols - x), 0), channel(x * y, 128), 255});
+            }
+        }
+        for (int y = 0; y < cellRows; y += 4) {
+            write(0, y, "hello world", {255, 255, 255, 255});
+        }
+        fill({cellCols / 8, cellRows / 6, cellCols / 4, cellRows / 3}, ' ', {0, 0, 0, 0}, {255, 0, 0, 200});
+        drawLine(cellCols / 8, cellRows / 2, cellCols - 1, cellRows - 1, ' ', {255, 255, 255, 255}, {0, 255, 0, 150});
+    }
+
+    void runDrawBenchmarks() {
+        const SDL_Color white = {255, 255, 255, 255};
+        const SDL_Color opaque = {40, 80, 120, 255};
+        const SDL_Color translucent = {200, 100, 50, 150};
+        const std::string line(cellCols, 'a');
+
+        report("clearBuffer", grid, "-", "median", measure([this]() { clearBuffer(); }));
+        report("draw_opaque", grid, "-", "median", measure([&]() {
+            for (int y = 0; y < cellRows; y ++) {
+                for (int x = 0; x < cellCols; x ++) {
+                    draw(x, y, 'a', white, opaque);
+                }
+            }
+        }));
+        report("draw_translucent", grid, "-", "median", measure([&]() {
+            for (int y = 0; y < cellRows; y ++) {
+                for (int x = 0; x < cellCols; x ++) {
+                    draw(x, y, 'a', white, translucent);
+                }
+            }
+        }));
+        report("write", grid, "-", "median", measure([&]() {
+            for (int y = 0; y < cellRows; y ++) {
+                write(0, y, line, white, translucent);
+            }
+        }));
+        const std::string paragraph = "The {fg:FFD700}quick{/} brown fox jumps over the lazy dog. ";
+        std::string text;
+        for (int i = 0; i < cellRows * cellCols / 64; i ++) {
+            text += paragraph;
+        }
+        report("writeText", grid, "-", "median", measure([&]() {
+            writeText({0, 0, cellCols, cellRows}, text, white, translucent, TextAlign::Center);
+        }));
+        report("writeCachedText", grid, "-", "median", measure([&]() {
+            writeCachedText({0, 0, cellCols, cellRows}, text, white, translucent, TextAlign::Center);
+        }));
+        report("fill", grid, "-", "median", measure([&]() {
+            fill({0, 0, cellCols, cellRows}, ' ', {0, 0, 0, 0}, translucent);
+        }));
+        report("drawLine", grid, "-", "median", measure([&]() {
+            for (int y = 0; y < cellRows; y ++) {
+                drawLine(0, y, cellCols - 1, cellRows - 1 - y, ' ', white, translucent);
+            }
+        }));
+        report("drawLine_clipped", grid, "-", "median", measure([&]() {
+            for (int y = 0; y < cellRows; y ++) {
+                drawLine(-cellCols, y - cellRows, cellCols * 2, cellRows * 2 - y, ' ', white, translucent);
+            }
+        }));
+        report("fillCircle", grid, "-", "median", measure([&]() {
+            fillCircle(cellCols / 2, cellRows / 2, cellRows / 2, ' ', white, translucent);
+        }));
+        report("fillTriangle", grid, "-", "median", measure([&]() {
+            fillTriangle(0, 0, cellCols - 1, cellRows / 2, cellCols / 3, cellRows - 1, ' ', white, translucent);
+        }));
+        report("drawFrame", grid, "-", "median", measure([&]() {
+            for (int i = 0; i < cellRows / 2; i += 2) {
+                drawFrame({i, i, cellCols - 2 * i, cellRows - 2 * i}, FrameStyle::Double, white, opaque);
+            }
+        }));
+        CellImage sprite(6, 8);
+        for (int y = 0; y < 6; y ++) {
+            for (int x = 1; x < 7; x ++) {
+                sprite.set(x, y, '#', white, y == 0 ? translucent : opaque);
+            }
+        }
+        report("blit_sprites", grid, "-", "median", measure([&]() {
+            for (int i = 0; i < cellRows * cellCols / 48; i ++) {
+                blit(sprite, (i * 37) % cellCols - 4, (i * 11) % cellRows - 3);
+            }
+        }));
+        std::vector<SDL_Color> colors(cellRows * cellCols, opaque);
+        report("blendColor", grid, "-", "median", measure([&]() {
+            for (SDL_Color& color : colors) {
+                color = blendColor(color, translucent);
+            }
+        }));
+    }
+};
+
+int main(int argc, char** argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 300;
+    const int sizes[][2] = {{30, 40}, {45, 80}, {90, 160}, {135, 240}, {180, 320}};
+    struct Config {
+        const char* name;
+        RenderBackend backend;
+        bool retained;
+    };
+    const Config configs[] = {
+        {"geometry", RenderBackend::Geometry, false},
+        {"texture", RenderBackend::Texture, false},
+        {"retained", RenderBackend::Geometry, true},
+        {"software", RenderBackend::Software, false},
+        {"software_retained", RenderBackend::Software, true},
+    };
+
+#if defined(RCE_AVX2)
+    const char* simd = "avx2";
+#elif defined(RCE_SSE2)
+    const char* simd = "sse2";
+#else
+    const char* simd = "scalar";
+#endif
+    printf("# simd=%s hardware_threads=%u frames=%d cell=8x8\n", simd, std::thread::hardware_concurrency(), frames);
+    printf("benchmark,grid,config,stat,us\n");
+    for (auto& size : sizes) {
+        char grid[16];
+        snprintf(grid, sizeof(grid), "%dx%d", size[1], size[0]);
+        for (const Config& config : configs) {
+            FrameBench bench(grid, config.name, config.backend, config.retained, &config == &configs[0], frames);
+            if (!bench.createConsole("./RCE_tileset.png", size[0], size[1], 8, 8)) {
+                return 1;
+            }
+            bench.init();
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+/**
+ * @file parity.cpp
+ * @brief renders the same cells offscreen with the texture backend and
+ * the software backend and compares the pixels of the two frames
+ *
+ * g++ -O2 parity.cpp -o parity -pthread -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+ * ./parity [tolerance]     (default: 4, run from the directory of RCE_tileset.png)
+ *
+ * SDL blends with truncating integer arithmetic that differs slightly
+ * between versions, so channels may differ by up to tolerance. Exits
+ * with 1 if any pixel of the unscaled grid differs by more; the scaled
+ * grid is only reported, as SDL versions also sample scaled glyphs
+ * differently.
+ */
+#include "../RCEngine.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+class ParityScene : public RCEngine {
+public:
+    ParityScene(RenderBackend backend, bool retained) {
+        displayMode = DisplayMode::Offscreen;
+        renderBackend = backend;
+        retainedMode = retained;
+        fixedDeltaTime = 1.0 / 60.0;
+        frameLimit = 3;
+    }
+
+    bool start() override {
+        return true;
+    }
+
+    bool update(double) override {
+        return true;
+    }
+
+    bool render(double) override {
+        Uint32 seed = 12345;
+        auto next = [&seed]() {
+            seed = seed * 1103515245u + 12345u;
+            return static_cast<Uint8>(seed >> 16);
+        };
+        const Uint8 alphas[] = {0, 1, 64, 128, 200, 254, 255};
+        for (int y = 0; y < cellRows; y ++) {
+            for (int x = 0; x < cellCols; x ++) {
+                Uint32 ch = (x + y * cellCols) % 256;
+                SDL_Color fore = {next(), next(), next(), alphas[next() % 7]};
+                SDL_Color back = {next(), next(), next(), alphas[next() % 7]};
+                draw(x, y, ch, fore, back);
+            }
+        }
+        // the rest of the frame is the same every frame for retained mode
+        write(0, 0, "frame " + std::to_string(getFrameCount()), {255, 255, 255, 255}, {0, 0, 128, 255});
+        if (getFrameCount() == frameLimit - 1) {
+            captureFrame();
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief renders the scene with a backend and returns its last frame
+ *
+ */
+static FrameCapture renderScene(RenderBackend backend, bool retained, int rows, int cols, int cellSize) {
+    ParityScene scene(backend, retained);
+    if (!scene.createConsole("./RCE_tileset.png", rows, cols, cellSize, cellSize)) {
+        exit(1);
+    }
+    scene.init();
+    return scene.getCapturedFrame();
+}
+
+/**
+ * @brief prints how much two frames differ
+ *
+ * @return int the largest difference of a channel
+ */
+static int compare(const char* name, const FrameCapture& expected, const FrameCapture& actual, int tolerance) {
+    if (expected.frame < 0 || actual.frame < 0 || expected.pixels.size() != actual.pixels.size()) {
+        printf("%-24s missing frame\n", name);
+        return 256;
+    }
+    int maxDiff = 0;
+    long over = 0;
+    for (size_t i = 0; i < expected.pixels.size(); i ++) {
+        int diff = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int a = (expected.pixels[i] >> shift) & 0xFF;
+            int b = (actual.pixels[i] >> shift) & 0xFF;
+            diff = std::max(diff, abs(a - b));
+        }
+        maxDiff = std::max(maxDiff, diff);
+        over += diff > tolerance;
+    }
+    printf("%-24s max_diff=%d pixels_over_tolerance=%ld/%zu\n", name, maxDiff, over, expected.pixels.size());
+    return maxDiff;
+}
+
+int main(int argc, char** argv) {
+    int tolerance = argc > 1 ? atoi(argv[1]) : 4;
+    bool passed = true;
+
+    // cells the size of the 24x24 tiles of RCE_tileset.png
+    FrameCapture texture = renderScene(RenderBackend::Texture, false, 16, 16, 24);
+    passed &= compare("software_24x24", texture, renderScene(RenderBackend::Software, false, 16, 16, 24), tolerance) <= tolerance;
+    passed &= compare("software_retained_24x24", texture, renderScene(RenderBackend::Software, true, 16, 16, 24), tolerance) <= tolerance;
+
+    FrameCapture scaled = renderScene(RenderBackend::Texture, false, 30, 40, 8);
+    compare("software_8x8", scaled, renderScene(RenderBackend::Software, false, 30, 40, 8), tolerance);
+
+    printf(passed ? "parity ok\n" : "parity FAILED\n");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file particles.cpp
+ * @brief benchmark of the particle system: moving the particles serially
+ * and on the thread pool, and drawing them with each blend, against
+ * particles stored as structs and stamped one by one with draw
+ *
+ * g++ -O2 particles.cpp -o particles -pthread -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+ * ./particles [particles]     (default: 100000)
+ *
+ * Prints one CSV line per result: benchmark,grid,config,stat,us
+ */
+#include "../RCEngine.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * @brief a particle of the hand-rolled baseline
+ *
+ */
+struct LooseParticle {
+    float x;
+    float y;
+    float vx;
+    float vy;
+    float age;
+    float life;
+    SDL_Color color;
+};
+
+class ParticleBench : public RCEngine {
+    const char* grid;
+    int particles;
+
+public:
+    ParticleBench(const char* grid, int particles) {
+        displayMode = DisplayMode::Null;
+        frameLimit = 1;
+        this->grid = grid;
+        this->particles = particles;
+    }
+
+    bool start() override {
+        const double dt = 1.0 / 60.0;
+        // rain falling over the whole console, living long enough to stay at the count
+        ParticleEmitter rain = {};
+        rain.x = 0.0f;
+        rain.y = 0.0f;
+        rain.width = static_cast<float>(cellCols);
+        rain.height = static_cast<float>(cellRows);
+        rain.velocityY = cellRows / 2.0f;
+        rain.spreadX = 1.0f;
+        rain.spreadY = cellRows / 8.0f;
+        rain.life = 1000.0f;
+        rain.ch = '|';
+        rain.color = {120, 160, 255, 160};
+
+        ParticleSystem system(particles);
+        system.gravityY = 4.0f;
+        system.drag = 0.1f;
+        system.burst(rain, particles);
+
+        std::vector<LooseParticle> loose(particles);
+        for (int i = 0; i < particles; i ++) {
+            loose[i] = {system.getPositionsX()[i], system.getPositionsY()[i], 0.0f, rain.velocityY, 0.0f, rain.life, rain.color};
+        }
+
+        report("update_structs", "-", measure([&]() {
+            float damping = 1.0f - system.drag * static_cast<float>(dt);
+            for (LooseParticle& p : loose) {
+                p.vx = p.vx * damping;
+                p.vy = p.vy * damping + system.gravityY * static_cast<float>(dt);
+                p.x += p.vx * static_cast<float>(dt);
+                p.y += p.vy * static_cast<float>(dt);
+                p.age += static_cast<float>(dt);
+            }
+        }));
+        report("update", "serial", measure([&]() { system.update(dt); }));
+        report("update", "parallel", measure([&]() { system.update(dt, &getThreadPool()); }));
+
+        // keep the particles on the console for drawing
+        system.clear();
+        system.burst(rain, particles);
+        fill({0, 0, cellCols, cellRows}, ' ', {0, 0, 0, 255}, {10, 10, 30, 255});
+        report("draw_structs", "-", measure([&]() {
+            for (const LooseParticle& p : loose) {
+                draw(static_cast<int>(p.x), static_cast<int>(p.y), '|', p.color, {0, 0, 0, 0});
+            }
+        }));
+        report("drawParticles", "alpha", measure([&]() { drawParticles(system, ParticleBlend::Alpha); }));
+        report("drawParticles", "additive", measure([&]() { drawParticles(system, ParticleBlend::Additive); }));
+        return true;
+    }
+
+    bool update(double) override {
+        return true;
+    }
+
+    bool render(double) override {
+        return true;
+    }
+
+private:
+    void report(const char* benchmark, const char* config, double us) {
+        printf("%s,%s,%s,median,%.3f\n", benchmark, grid, config, us);
+    }
+
+    /**
+     * @brief the median time of one call of f in microseconds, over 15 calls
+     *
+     */
+    template <typename F>
+    static double measure(F&& f) {
+        const int samples = 15;
+        double times[samples];
+        f();
+        for (int s = 0; s < samples; s ++) {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            times[s] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::sort(times, times + samples);
+        return times[samples / 2];
+    }
+};
+
+int main(int argc, char** argv) {
+    int particles = argc > 1 ? atoi(argv[1]) : 100000;
+    const int sizes[][2] = {{30, 40}, {90, 160}, {180, 320}};
+
+#if defined(RCE_AVX2)
+    const char* simd = "avx2";
+#elif defined(RCE_SSE2)
+    const char* simd = "sse2";
+#else
+    const char* simd = "scalar";
+#endif
+    printf("# simd=%s hardware_threads=%u particles=%d\n", simd, std::thread::hardware_concurrency(), particles);
+    printf("benchmark,grid,config,stat,us\n");
+    for (auto& size : sizes) {
+        char grid[16];
+        snprintf(grid, sizeof(grid), "%dx%d", size[1], size[0]);
+        ParticleBench bench(grid, particles);
+        if (!bench.createConsole("./RCE_tileset.png", size[0], size[1], 8, 8)) {
+            return 1;
+        }
+        bench.init();
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file raster.cpp
+ * @brief benchmark of the software backend rasterizing bands in
+ * parallel, for several thread counts, with every band changed and
+ * with a single band changed per frame
+ *
+ * g++ -O2 raster.cpp -o raster -pthread -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+ * ./raster [threads...]     (default: 1 2 4 8, run from the directory of RCE_tileset.png)
+ */
+#include "../RCEngine.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+class RasterBench : public RCEngine {
+    int frame;
+
+public:
+    RasterBench(int threads) {
+        displayMode = DisplayMode::Offscreen;
+        renderBackend = RenderBackend::Software;
+        workerThreads = threads;
+        frame = 0;
+    }
+
+    bool start() override {
+        return true;
+    }
+
+    bool update(double) override {
+        return true;
+    }
+
+    bool render(double) override {
+        return true;
+    }
+
+    /**
+     * @brief draws a frame that differs from the previous one in every
+     * cell, or only in the cells of the first row
+     *
+     */
+    void drawFrame(bool everyRow) {
+        frame ++;
+        int rows = everyRow ? cellRows : 1;
+        for (int y = 0; y < rows; y ++) {
+            for (int x = 0; x < cellCols; x ++) {
+                Uint8 shade = static_cast<Uint8>((x + y + frame) * 7);
+                draw(x, y, 'A' + (x + frame) % 26, {255, shade, 0, 255}, {0, 0, shade, 255});
+            }
+        }
+    }
+};
+
+template <typename F>
+static double measure(F&& f) {
+    const int repeats = 50;
+    f();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i ++) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / repeats;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> threadCounts;
+    for (int i = 1; i < argc; i ++) {
+        threadCounts.push_back(atoi(argv[i]));
+    }
+    if (threadCounts.empty()) {
+        threadCounts = {1, 2, 4, 8};
+    }
+    const int sizes[][2] = {{90, 160}, {180, 320}};
+
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    printf("hardware_threads=%u cell=8x8\n", hardwareThreads);
+    printf("%-8s %-8s %12s %12s %8s\n", "grid", "threads", "all_us", "one_band_us", "speedup");
+    for (auto& size : sizes) {
+        double single = 0.0;
+        for (int threads : threadCounts) {
+            RasterBench bench(threads);
+            if (!bench.createConsole("./RCE_tileset.png", size[0], size[1], 8, 8)) {
+                return 1;
+            }
+            double all = measure([&]() { bench.drawFrame(true); bench.renderBuffer(); });
+            double oneBand = measure([&]() { bench.drawFrame(false); bench.renderBuffer(); });
+            if (single == 0.0) {
+                single = all;
+            }
+            char grid[16];
+            snprintf(grid, sizeof(grid), "%dx%d", size[1], size[0]);
+            // more threads than cores measure contention, not scaling
+            const char* note = hardwareThreads > 0 && static_cast<unsigned>(threads) > hardwareThreads ? " oversubscribed" : "";
+            printf("%-8s %-8d %12.1f %12.1f %8.2f%s\n", grid, threads, all, oneBand, single / all, note);
+        }
+    }
+    return 0;
+}
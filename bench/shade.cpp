@@ -0,0 +1,108 @@
+/**
+ * @file shade.cpp
+ * @brief benchmark of RCEngine::forEachCell against the serial draw loop
+ * of the demo, for several thread counts
+ *
+ * g++ -O2 shade.cpp -o shade -pthread -lSDL2 -lSDL2_image -lSDL2_ttf -lSDL2_mixer
+ * ./shade [threads...]     (default: 1 4 8 16)
+ */
+#include "../RCEngine.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+class ShadeBench : public RCEngine {
+public:
+    double t;
+
+    ShadeBench(int threads) {
+        displayMode = DisplayMode::Null;
+        workerThreads = threads;
+        t = 0.0;
+    }
+
+    bool start() override {
+        return true;
+    }
+
+    bool update(double deltaTime) override {
+        t += deltaTime * 120.0;
+        return true;
+    }
+
+    bool render(double) override {
+        return true;
+    }
+
+    /**
+     * @brief the per-cell color of the demo
+     *
+     */
+    Cell shade(int x, int y) const {
+        return {' ', {255, 255, 255, 255},
+            {channel(x * (cellRows - y), 255), channel(y * (cellCols - x), 0), channel(x * y, 128), 255}};
+    }
+
+    Uint8 channel(int n, int offset) const {
+        n += t;
+        int x = (static_cast<int>(round(t)) + n + offset) % 500;
+        return static_cast<Uint8>(abs(255 - x));
+    }
+
+    void drawSerial() {
+        for (int y = 0; y < cellRows; y ++) {
+            for (int x = 0; x < cellCols; x ++) {
+                Cell cell = shade(x, y);
+                draw(x, y, cell.ch, cell.foreColor, cell.backColor);
+            }
+        }
+    }
+
+    void drawParallel() {
+        forEachCell([this](int x, int y) { return shade(x, y); });
+    }
+};
+
+template <typename F>
+static double measure(F&& f) {
+    const int repeats = 100;
+    f();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i ++) {
+        f();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / repeats;
+}
+
+int main(int argc, char** argv) {
+    std::vector<int> threadCounts;
+    for (int i = 1; i < argc; i ++) {
+        threadCounts.push_back(atoi(argv[i]));
+    }
+    if (threadCounts.empty()) {
+        threadCounts = {1, 4, 8, 16};
+    }
+    const int sizes[][2] = {{30, 40}, {135, 240}, {180, 320}};
+
+    unsigned hardwareThreads = std::thread::hardware_concurrency();
+    printf("hardware_threads=%u\n", hardwareThreads);
+    printf("%-8s %-8s %10s %10s %8s\n", "grid", "threads", "serial_us", "shade_us", "speedup");
+    for (auto& size : sizes) {
+        for (int threads : threadCounts) {
+            ShadeBench bench(threads);
+            if (!bench.createConsole("./RCE_tileset.png", size[0], size[1])) {
+                return 1;
+            }
+            bench.update(0.1);
+            double serial = measure([&]() { bench.drawSerial(); });
+            double parallel = measure([&]() { bench.drawParallel(); });
+            char grid[16];
+            snprintf(grid, sizeof(grid), "%dx%d", size[1], size[0]);
+            // more threads than cores measure contention, not scaling
+            const char* note = hardwareThreads > 0 && static_cast<unsigned>(threads) > hardwareThreads ? " oversubscribed" : "";
+            printf("%-8s %-8d %10.1f %10.1f %8.2f%s\n", grid, threads, serial, parallel, serial / parallel, note);
+        }
+    }
+    return 0;
+}
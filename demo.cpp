@@ -25,6 +25,7 @@ class Demo : public RCEngine {
 public:
     Demo() {
         windowTitle = "Demo";
+        maxFrameRate = 60.0;
     }
 
     bool start() override {